@@ -0,0 +1,198 @@
+// glito/Benchmark.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+  
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#include <ctime>
+#include <cstdlib>
+#include <iomanip>
+
+#include "Benchmark.hpp"
+#include "Engine.hpp"
+#include "Image.hpp"
+#include "IndentedString.hpp"
+
+namespace {
+    /** milli-seconds to plot #points# points of #skel# in #image#, with #bins#
+	if not NULL, else with a PlotPipeline of #distance#
+    */
+    float timePlotting( const Skeleton& skel, Image& image, PlotBins* bins,
+			const int distance, const int points ) {
+	float x, y, color;
+	const Zoom zoom( skel.findFrame( 100000, x, y, color ),
+			 image.w(), image.h(), skel.getZoomFunction() );
+	// the same orbit for every measure
+	srand(1);
+	skel.setXY( x, y, color );
+	if ( bins != NULL ) {
+	    bins->bind( image );
+	}
+	const clock_t clock0 = clock();
+	{
+	    PlotPipeline pipeline( image, distance );
+	    for ( int i = 0; i < points; ++i ) {
+		// as Engine::iterBuildPoints, new seeds for the formulas
+		if ( ( Function::system == FORMULA || Function::system == SINUSOIDAL )
+		     && i % 1000 == 0 ) {
+		    x = (float)rand()*2/RAND_MAX - 1;
+		    y = (float)rand()*2/RAND_MAX - 1;
+		    skel.setXY( x, y, color );
+		}
+		skel.nextPoint( x, y, color );
+		zoom.toScreen( x, y );
+		if ( bins != NULL ) {
+		    bins->plot( zoom.screenX, zoom.screenY, color );
+		} else {
+		    pipeline.plot( zoom.screenX, zoom.screenY, color );
+		}
+	    }
+	}
+	if ( bins != NULL ) {
+	    bins->flush();
+	}
+	return (float)( clock() - clock0 ) * 1000 / CLOCKS_PER_SEC;
+    }
+
+    /** percentage of the points of #skel# which hit the cache line of 64
+	bytes of int counters hit by the previous point, for images of
+	#side#x#side# stored by rows or by bricks
+    */
+    void sameLine( const Skeleton& skel, const int side, const int points,
+		   float& rows, float& bricks ) {
+	float x, y, color;
+	const Zoom zoom( skel.findFrame( 100000, x, y, color ),
+			 side, side, skel.getZoomFunction() );
+	srand(1);
+	skel.setXY( x, y, color );
+	const int shift = ImageBrickDensity::brickShift;
+	const int bricksX = ( side + (1 << shift) - 1 ) >> shift;
+	int lastRow = -1;
+	int lastBrick = -1;
+	int sameRow = 0;
+	int sameBrick = 0;
+	for ( int i = 0; i < points; ++i ) {
+	    if ( ( Function::system == FORMULA || Function::system == SINUSOIDAL )
+		 && i % 1000 == 0 ) {
+		x = (float)rand()*2/RAND_MAX - 1;
+		y = (float)rand()*2/RAND_MAX - 1;
+		skel.setXY( x, y, color );
+	    }
+	    skel.nextPoint( x, y, color );
+	    zoom.toScreen( x, y );
+	    const int sx = zoom.screenX;
+	    const int sy = zoom.screenY;
+	    // 16 ints per line
+	    const int row = ( sx + sy*side ) >> 4;
+	    const int brick = ( ( ( (sx >> shift) + (sy >> shift)*bricksX ) << (2*shift) )
+				+ ( (sy & ((1 << shift)-1)) << shift ) + ( sx & ((1 << shift)-1) ) ) >> 4;
+	    sameRow += ( row == lastRow );
+	    sameBrick += ( brick == lastBrick );
+	    lastRow = row;
+	    lastBrick = brick;
+	}
+	rows = 100.0 * sameRow / points;
+	bricks = 100.0 * sameBrick / points;
+    }
+
+    /// skeleton stored in the IFS or PNG file #file#. "" if it can not be read
+    std::string readSkeleton( const std::string& file ) {
+#ifdef HAVE_LIBPNG
+	try {
+	    return ImageGray::getDescriptionFromPNG( file );
+	} catch ( const int e ) {
+	    if ( e != 1 ) { // a PNG file without skeleton
+		return "";
+	    }
+	}
+#endif // HAVE_LIBPNG
+	return IS::readStringInFile( file );
+    }
+}
+
+void
+Benchmark::plotting( std::ostream& out, const int points ) {
+    const systemType oldSystem = Function::system;
+    Function::system = LINEAR;
+    const Skeleton skel;
+    PlotBins bins;
+    const int nbDistances = 3;
+    const int distances[nbDistances] = { 8, 16, 32 };
+    int crossover = 0;
+    int bestDistance = 0;
+    out << "pixels\tdirect (ms)";
+    for ( int d = 0; d < nbDistances; ++d ) {
+	out << "\tprefetch " << distances[d];
+    }
+    out << "\tbinned (ms)\n";
+    for ( int side = 256; side <= 8192; side *= 2 ) {
+	ImageDensity image( side, side, false );
+	const float direct = timePlotting( skel, image, NULL, 0, points );
+	out << side << "x" << side << "\t" << std::setw(8) << direct;
+	float best = direct;
+	for ( int d = 0; d < nbDistances; ++d ) {
+	    image.mem_clear();
+	    const float prefetched = timePlotting( skel, image, NULL, distances[d], points );
+	    out << "\t" << std::setw(8) << prefetched;
+	    // the prefetch is made for the images between 2 and 8 millions of pixels
+	    if ( side == 2048 && prefetched < best ) {
+		best = prefetched;
+		bestDistance = distances[d];
+	    }
+	}
+	image.mem_clear();
+	const float binned = timePlotting( skel, image, &bins, 0, points );
+	out << "\t" << std::setw(8) << binned << "\n";
+	if ( crossover == 0 && binned < direct ) {
+	    crossover = side*side;
+	}
+    }
+    if ( crossover != 0 ) {
+	out << "binningPixels: " << crossover << "\n";
+    } else {
+	out << "binningPixels: PlotBins is never faster\n";
+    }
+    out << "prefetchDistance: " << bestDistance << "\n";
+    Function::system = oldSystem;
+}
+
+void
+Benchmark::layouts( std::ostream& out, const std::vector<std::string>& files,
+		    const int side, const int points ) {
+    const systemType oldSystem = Function::system;
+    float totalRows = 0;
+    float totalBricks = 0;
+    out << side << "x" << side << ", " << points << " points\n"
+	<< "skeleton\trows (ms)\tbricks (ms)\tsame line rows/bricks (%)\n";
+    for ( std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f ) {
+	Skeleton skel;
+	if ( !skel.fromXML( readSkeleton( *f ) ) ) {
+	    out << *f << "\tnot a skeleton\n";
+	    continue;
+	}
+	ImageDensity rowImage( side, side, false );
+	const float rows = timePlotting( skel, rowImage, NULL, 0, points );
+	ImageBrickDensity brickImage( side, side, false );
+	const float bricks = timePlotting( skel, brickImage, NULL, 0, points );
+	float sameRow, sameBrick;
+	sameLine( skel, side, points, sameRow, sameBrick );
+	out << *f << "\t" << std::setw(8) << rows << "\t" << std::setw(8) << bricks
+	    << "\t" << std::setw(5) << sameRow << " / " << sameBrick << "\n";
+	totalRows += rows;
+	totalBricks += bricks;
+    }
+    out << "total\t" << std::setw(8) << totalRows << "\t" << std::setw(8) << totalBricks << "\n";
+    Function::system = oldSystem;
+}
@@ -0,0 +1,49 @@
+// glito/Benchmark.hpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+  
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** benchmarks of the calculation of the images, run by "glito -b".
+    They do not need a display.
+ */
+namespace Benchmark {
+
+    /** time to plot #points# points of the dragon in density images of
+	increasing size, directly, with PlotPipeline and with PlotBins.
+	Writes a table to #out#, the smallest size where PlotBins is faster
+	(Engine::binningPixels) and the best prefetch distance for 2048x2048
+	(Engine::prefetchDistance, 0 if prefetching is slower)
+    */
+    void plotting( std::ostream& out, int points = 10000000 );
+
+    /** time to plot #points# points of each skeleton of #files# (IFS or
+	PNG) in images of #side#x#side# pixels stored by rows (ImageDensity)
+	and by bricks (ImageBrickDensity). Writes a table to #out# with the
+	percentage of points hitting the same cache line as the previous one
+    */
+    void layouts( std::ostream& out, const std::vector<std::string>& files,
+		  int side = 2048, int points = 2000000 );
+
+}
+
+#endif // BENCHMARK_HPP
@@ -0,0 +1,140 @@
+// glito/Checkpoint.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#include <limits>
+
+#include "Checkpoint.hpp"
+#include "GzFile.hpp"
+
+using namespace GzFile;
+
+namespace {
+    const char magic[] = "glito checkpoint\n";
+}
+
+Checkpoint::Checkpoint()
+    : width(0), height(0), colored(false), factor(1),
+      xmin(0), xmax(0), ymin(0), ymax(0), x(0), y(0), color(0), saved(1) {
+}
+
+void
+Checkpoint::resize( const int w, const int h, const bool c ) {
+    width = w;
+    height = h;
+    colored = c;
+    hits.resize( (size_t)w*h );
+    coords.resize( c ? (size_t)w*h : 0 );
+}
+
+int
+Checkpoint::save( const std::string& file ) const {
+    gzFile f = create( file );
+    if ( f == NULL ) {
+	return 0;
+    }
+    const float floats[7] = { xmin, xmax, ymin, ymax, x, y, color };
+    const bool written = writeHeader( f, magic, version )
+	&& writeInt( f, width ) && writeInt( f, height )
+	&& writeInt( f, colored ? 1 : 0 ) && writeInt( f, factor )
+	&& write( f, floats, sizeof(floats) )
+	&& writeInt( f, (int)skeleton.size() )
+	&& write( f, skeleton.data(), skeleton.size() )
+	&& write( f, &hits[0], hits.size()*sizeof(int) )
+	&& ( !colored || write( f, &coords[0], coords.size()*sizeof(float) ) );
+    return commit( f, file, written );
+}
+
+int
+Checkpoint::load( const std::string& file ) {
+    gzFile f = gzopen( file.c_str(), "rb" );
+    if ( f == NULL ) {
+	return 0;
+    }
+    int w = 0;
+    int h = 0;
+    int c = 0;
+    int length = 0;
+    float floats[7];
+    bool valid = readHeader( f, magic, version )
+	&& readInt( f, w ) && readInt( f, h ) && w > 0 && h > 0
+	&& readInt( f, c ) && readInt( f, factor ) && factor > 0
+	&& read( f, floats, sizeof(floats) )
+	&& readInt( f, length ) && length >= 0;
+    if ( valid ) {
+	resize( w, h, c != 0 );
+	std::vector<char> xml( length + 1, '\0' );
+	valid = read( f, &xml[0], length )
+	    && read( f, &hits[0], hits.size()*sizeof(int) )
+	    && ( !colored || read( f, &coords[0], coords.size()*sizeof(float) ) );
+	skeleton = &xml[0];
+    }
+    gzclose( f );
+    if ( !valid ) {
+	resize( 0, 0, false );
+	return 0;
+    }
+    xmin = floats[0];
+    xmax = floats[1];
+    ymin = floats[2];
+    ymax = floats[3];
+    x = floats[4];
+    y = floats[5];
+    color = floats[6];
+    return 1;
+}
+
+bool
+Checkpoint::sameFrame( const Checkpoint& other ) const {
+    return width == other.width && height == other.height
+	&& colored == other.colored && factor == other.factor
+	&& xmin == other.xmin && xmax == other.xmax
+	&& ymin == other.ymin && ymax == other.ymax
+	&& skeleton == other.skeleton;
+}
+
+void
+Checkpoint::add( const Checkpoint& other ) {
+    // as ImageDensity::maxMaxHit
+    const long long maxHit = std::numeric_limits<int>::max() - 1;
+    for ( size_t n = 0; n < hits.size(); ++n ) {
+	const long long sum = (long long)hits[n] + other.hits[n];
+	if ( colored && sum != 0 ) {
+	    coords[n] = ( (double)hits[n] * coords[n]
+			  + (double)other.hits[n] * other.coords[n] ) / sum;
+	}
+	hits[n] = (int)( sum < maxHit ? sum : maxHit );
+    }
+}
+
+void
+Checkpoint::saveInBackground( const std::string& file ) {
+    writer.wait();
+    target = file;
+    writer.start( *this );
+}
+
+int
+Checkpoint::wait() {
+    writer.wait();
+    return saved;
+}
+
+void
+Checkpoint::run() {
+    saved = save( target );
+}
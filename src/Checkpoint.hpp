@@ -0,0 +1,128 @@
+// glito/Checkpoint.hpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "Parallel.hpp"
+
+/** state of the calculation of a density image saved to a file, so that
+    a long calculation can be stopped and resumed, or its hits tone mapped
+    again later.
+    The file is compressed by zlib (gzip format). It contains, in the
+    byte order of the machine which wrote it:
+    - "glito checkpoint\n" and the version (int)
+    - width and height of the counters, 1 if colored, supersampling (ints)
+    - framing: xmin, xmax, ymin, ymax (floats)
+    - last point of the orbit: x, y, color (floats)
+    - length of the XML of the skeleton (int), then the XML
+    - number of hits of the pixels (width*height ints), row after row
+    - if colored, mean color coordinates of the pixels (width*height floats)
+*/
+class Checkpoint : public BackgroundTask {
+public:
+    /// empty checkpoint
+    Checkpoint();
+
+    /// set the size of the tables of hits and coordinates
+    void resize( int w, int h, bool colored );
+
+    /** write the checkpoint to #file#.tmp, then rename it #file#: a file
+	is never left half written. returns 1 if succeed, 0 if failed
+    */
+    int save( const std::string& file ) const;
+
+    /** read #file#. returns 1 if succeed, 0 if it is not a checkpoint of
+	this version (the checkpoint is then empty)
+    */
+    int load( const std::string& file );
+
+    /** save() to #file# by a second thread. wait() must be called before
+	the checkpoint is changed again
+    */
+    void saveInBackground( const std::string& file );
+
+    /// wait for the end of saveInBackground(). returns the result of the last save(), 1 if none
+    int wait();
+
+    /** true if #other# has the same size, framing and skeleton: both
+	calculate the same image and their hits can be added
+    */
+    bool sameFrame( const Checkpoint& other ) const;
+
+    /** add the hits of #other# (see sameFrame) to this checkpoint. The
+	color coordinates are averaged, weighted by the hits. used by
+	glito-merge to gather the calculations of several computers
+    */
+    void add( const Checkpoint& other );
+
+    /// called by the second thread
+    void run();
+
+    static const int version = 1;
+
+    int width;
+    int height;
+    bool colored;
+
+    /// the counters are #factor# times larger than the image. see ImageSupersampled
+    int factor;
+
+    // { MinMax of the framing
+    float xmin;
+    float xmax;
+    float ymin;
+    float ymax;
+    // }
+
+    // { point of the orbit where the calculation stopped
+    float x;
+    float y;
+    float color;
+    // }
+
+    /// XML of the skeleton and of its system
+    std::string skeleton;
+
+    /// number of hits of each pixel, row after row
+    std::vector<int> hits;
+
+    /// mean color coordinate of each pixel if colored
+    std::vector<float> coords;
+
+private:
+    Checkpoint( const Checkpoint& );
+    Checkpoint& operator=( const Checkpoint& );
+
+    // { given to and returned by the second thread
+    std::string target;
+    int saved;
+    // }
+
+    /// last member: destroyed first, so the writing ends before the tables are freed
+    Parallel::Background writer;
+};
+
+#endif // CHECKPOINT_HPP
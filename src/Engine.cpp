@@ -22,6 +22,13 @@ USA.
 
 #include <cmath>
 // cos...
+#include <cstdio>
+// tmpfile
+#include <ctime>
+// time
+#include <iostream>
+#include <sstream>
+#include <algorithm>
  
 #ifndef M_PI
 # define M_PI		3.14159265358979323846	/* pi */
@@ -32,6 +39,13 @@ USA.
 #include "Engine.hpp"
 #include "Image.hpp"
 
+#ifdef ENABLE_NLS
+# include <libintl.h>
+# define _(String) gettext (String)
+#else
+# define _(String) (String)
+#endif
+
 void
 Julia::start( int nbFrames ) {
     if ( nbFrames == 1 ) {
@@ -89,6 +103,8 @@ Zoom::Zoom( const MinMax& minmax, const int w, const int h,
     }
     centerX = (int)(w/2 - minmax.centerX()*inter);
     centerY = (int)(h/2 + minmax.centerY()*inter);
+    cropX = 0;
+    cropY = 0;
     fx = inter;
     fy = -inter;
     julia.start(nbFrames);
@@ -99,8 +115,26 @@ Zoom::toScreen( float x, float y ) const {
     if ( zoomFunctionModified ) {
 	zoomFunction.previousPoint( x, y, false );
     }
-    screenX = (int)(centerX + x*fx);
-    screenY = (int)(centerY + y*fy);
+    screenX = (int)(centerX + x*fx) - cropX;
+    screenY = (int)(centerY + y*fy) - cropY;
+}
+
+MinMax
+Zoom::visible( const int w, const int h, const Function& view ) const {
+    // one more pixel around the image for the rounding of toScreen
+    const int corners[4][2] = { { -1, -1 }, { w + 1, -1 }, { -1, h + 1 }, { w + 1, h + 1 } };
+    MinMax box;
+    for ( int c = 0; c < 4; ++c ) {
+	float x = ( corners[c][0] + cropX - centerX ) / fx;
+	float y = ( corners[c][1] + cropY - centerY ) / fy;
+	if ( zoomFunctionModified ) {
+	    zoomFunction.affinePoint( x, y );
+	}
+	view.affinePoint( x, y );
+	box.candidates( x, y );
+    }
+    box.build();
+    return box;
 }
 
 Engine::Engine( int cornerX, int cornerY, int w, int h, const char *label )
@@ -110,9 +144,13 @@ Engine::Engine( int cornerX, int cornerY, int w, int h, const char *label )
       pointsPerFrame(20000), minimalBuiltPoints(1000),
       imageSavedWidth(800), imageSavedHeight(600),
       animationSavedWidth(160), animationSavedHeight(120),
+      posterPoints(20000000), posterMemory(256), binningPixels(defaultBinningPixels),
+      prefetchDistance(16), supersampling(1),
+      checkpointInterval(0), checkpointFile("glito-checkpoint.gz"), extraSizes(""),
+      pointCloudPoints(0), pointCloudQuantized(false),
       intervalFrame(40),
       clockNumber(true), skel2("triangle"),
-      trueDensity(true), colored(false) {
+      trueDensity(true), hitCounters(INT_COUNTERS), colored(false), resuming(false) {
     imageLarge = buildImage( w, h );
 }
 
@@ -120,23 +158,43 @@ Engine::~Engine() {
     for ( std::vector< Image* >::const_iterator i = images.begin(); i != images.end(); ++i ) {
 	delete *i;
     }
+    resetExtraImages( false );
     delete imageLarge;
 }
 
 void
 Engine::drawLargeView() {
-    const bool saving = ( state >= SAVEPGM && state <= SAVEPNG );
+    const bool saving = ( state >= SAVEPGM && state <= SAVEPFM );
     const int buildWidth = saving ? imageSavedWidth : w();
     const int buildHeight = saving ? imageSavedHeight : h();
-    Zoom zoom( skel.findFrame( pointsForFraming, _x, _y, _color ),
-	       buildWidth, buildHeight, skel.getZoomFunction() );
+    // the points are calculated in the large image of ImageSupersampled
+    const int factor = trueDensity ? supersampling : 1;
+    const bool replayed = !resuming && readyPointCloud();
+    MinMax framing;
+    if ( replayed ) {
+	framing = pointCloud.framing();
+	_x = pointCloud.x;
+	_y = pointCloud.y;
+	_color = pointCloud.color;
+    } else if ( resuming ) {
+	// the framing of the hits of the checkpoint
+	framing.candidates( checkpoint.xmin, checkpoint.ymin );
+	framing.candidates( checkpoint.xmax, checkpoint.ymax );
+	framing.build();
+	_x = checkpoint.x;
+	_y = checkpoint.y;
+	_color = checkpoint.color;
+    } else {
+	framing = skel.findFrame( pointsForFraming, _x, _y, _color );
+    }
+    Zoom zoom( framing, factor*buildWidth, factor*buildHeight, skel.getZoomFunction() );
     int xcenter = 0;
     int ycenter = 0;
     if ( saving ) {
         // at least one point will be in the center when we save:
 	zoom.toScreen( _x, _y );
-	xcenter = w()/2 - zoom.screenX;
-	ycenter = h()/2 - zoom.screenY;
+	xcenter = w()/2 - zoom.screenX/factor;
+	ycenter = h()/2 - zoom.screenY/factor;
 	if ( xcenter + imageSavedWidth < w() ) {
 	    xcenter = w() - imageSavedWidth;
 	}
@@ -150,25 +208,238 @@ Engine::drawLargeView() {
 	    ycenter = 0;
 	}
     }
-    resetImage( buildWidth, buildHeight, w(), h(), xcenter + ycenter*imageSavedWidth );
+    if ( factor > 1 ) {
+	delete imageLarge;
+	imageLarge = new ImageSupersampled( buildDensityImage( factor*buildWidth, factor*buildHeight ),
+					    factor, w(), h(), xcenter + ycenter*imageSavedWidth );
+    } else {
+	resetImage( buildWidth, buildHeight, w(), h(), xcenter + ycenter*imageSavedWidth );
+    }
+    if ( resuming ) {
+	ImageDensity* image = imageLarge->densityImage();
+	if ( image != NULL && image->w() == checkpoint.width && image->h() == checkpoint.height ) {
+	    for ( int j = 0; j < checkpoint.height; ++j ) {
+		image->setRow( j, &checkpoint.hits[ (size_t)j*checkpoint.width ],
+			       checkpoint.colored ? &checkpoint.coords[ (size_t)j*checkpoint.width ] : NULL );
+	    }
+	}
+	checkpoint.resize( 0, 0, false );
+	resuming = false;
+    }
+    // the extra images are framed on the whole fractal and share the orbit of imageLarge
+    resetExtraImages( saving );
+    std::vector<RenderTarget> targets;
+    addTarget( targets, zoom, imageLarge );
+    for ( size_t i = 0; i < extraImages.size(); ++i ) {
+	addTarget( targets, extraZoom( i, framing ), extraImages[i] );
+    }
+    if ( replayed ) {
+	// the images are drawn at once, the orbit continues from the last point of the cloud
+	for ( std::vector<RenderTarget>::iterator t = targets.begin(); t != targets.end(); ++t ) {
+	    PlotBins* bins = t->binned ? &t->bins : NULL;
+	    pointCloud.replay( t->zoom, *t->image, bins, prefetchFor( *t->image, bins ) );
+	}
+	flushTargets( targets );
+    }
     unsigned long timer = clock();
-    while ( state == LARGEVIEW || ( SAVEPGM <= state && state <= SAVEPNG ) ) {
- 	if ( clockNumber ) {
- 	    drawPoints( skel, zoom, *imageLarge, timer );
- 	} else {
- 	    drawPoints( skel, zoom, *imageLarge, pointsPerFrame );
- 	}
+    time_t lastCheckpoint = time(NULL);
+    while ( state == LARGEVIEW || ( SAVEPGM <= state && state <= SAVEPFM ) ) {
+	drawPoints( skel, targets, timer );
+	if ( saving && checkpointInterval > 0 && time(NULL) - lastCheckpoint >= checkpointInterval ) {
+	    writeCheckpoint( framing, factor );
+	    lastCheckpoint = time(NULL);
+	}
+    }
+    if ( saving && checkpointInterval > 0 ) {
+	// the calculation can be continued later
+	writeCheckpoint( framing, factor );
+    }
+}
+
+void
+Engine::writeCheckpoint( const MinMax& framing, const int factor ) {
+    ImageDensity* image = imageLarge->densityImage();
+    if ( image == NULL ) {
+	return;
+    }
+    if ( !checkpoint.wait() ) {
+	std::cerr << "Writing " << checkpointFile << " failed!\n";
+    }
+    checkpoint.resize( image->w(), image->h(), image->isColored() );
+    checkpoint.factor = factor;
+    checkpoint.xmin = framing.xMin();
+    checkpoint.xmax = framing.xMax();
+    checkpoint.ymin = framing.yMin();
+    checkpoint.ymax = framing.yMax();
+    checkpoint.x = _x;
+    checkpoint.y = _y;
+    checkpoint.color = _color;
+    checkpoint.skeleton = skel.toXML();
+    for ( int j = 0; j < checkpoint.height; ++j ) {
+	image->getRow( j, &checkpoint.hits[ (size_t)j*checkpoint.width ], NULL );
+	if ( checkpoint.colored ) {
+	    image->getCoordinates( j, &checkpoint.coords[ (size_t)j*checkpoint.width ] );
+	}
+    }
+    checkpoint.saveInBackground( checkpointFile );
+}
+
+bool
+Engine::readyPointCloud() {
+    if ( pointCloudPoints <= 0 || Function::system == JULIA ) {
+	return false;
+    }
+    const std::string xml = skel.toXML();
+    if ( pointCloud.matches( xml ) ) {
+	return true;
+    }
+    if ( !pointCloudFile.empty() && pointCloud.load( pointCloudFile, xml ) ) {
+	return true;
+    }
+    if ( !pointCloud.build( skel, pointCloudPoints, pointsForFraming, pointCloudQuantized ) ) {
+	return false;
+    }
+    if ( !pointCloudFile.empty() && !pointCloud.save( pointCloudFile ) ) {
+	std::cerr << "Writing " << pointCloudFile << " failed!\n";
+    }
+    return true;
+}
+
+bool
+Engine::resume( const std::string& file ) {
+    checkpoint.wait();
+    if ( !checkpoint.load( file ) ) {
+	return false;
+    }
+    const int factor = checkpoint.factor;
+    if ( factor > ImageSupersampled::maxFactor
+	 || checkpoint.width % factor != 0 || checkpoint.height % factor != 0
+	 || !skel.fromXML( checkpoint.skeleton ) ) {
+	checkpoint.resize( 0, 0, false );
+	return false;
+    }
+    trueDensity = true;
+    colored = checkpoint.colored;
+    supersampling = factor;
+    imageSavedWidth = checkpoint.width / factor;
+    imageSavedHeight = checkpoint.height / factor;
+    resuming = true;
+    return true;
+}
+
+#ifdef HAVE_LIBPNG
+namespace {
+    /// rows of a poster, read from the file where its bands were stored
+    class PosterRows : public ImageRows {
+    public:
+	PosterRows( FILE* f, int width, bool colored, int maxHit )
+	    : f(f), toneMap(maxHit), hits(width), rgb(colored ? 3*width : 0) {}
+
+	void getRow( int, unsigned char* gray, unsigned char* color ) {
+	    const int width = hits.size();
+	    const bool colored = !rgb.empty();
+	    if ( fread( &hits[0], sizeof(int), width, f ) != (size_t)width
+		 || ( colored && fread( &rgb[0], sizeof(float), 3*width, f ) != (size_t)(3*width) ) ) {
+		// truncated file: the rest of the poster stays empty
+		std::fill( hits.begin(), hits.end(), 0 );
+	    }
+	    for ( int x = 0; x < width; ++x ) {
+		toneMap.pixel( hits[x], colored ? &rgb[3*x] : NULL,
+			       gray[x], colored ? color + 3*x : NULL );
+	    }
+	}
+
+    private:
+	FILE* f;
+	const ToneMap toneMap;
+	std::vector<int> hits;
+	std::vector<float> rgb;
+    };
+}
+
+int
+Engine::drawPoster( FILE* fp, const std::string& description ) {
+    const int width = imageSavedWidth;
+    const int height = imageSavedHeight;
+    // tab and hitTab (ints at most), plus colorTab and the color coordinates if colored
+    const double bytesPerPixel = colored ? 1 + 4 + 3 + sizeof(float) : 1 + 4;
+    const int bandHeight = std::max( 1, std::min( height,
+	(int)( posterMemory * 1048576.0 / bytesPerPixel / width ) ) );
+    const int bands = ( height + bandHeight - 1 ) / bandHeight;
+    // the hits of the bands are stored row after row: they are read back in the same order
+    FILE* hitFile = tmpfile();
+    if ( hitFile == NULL ) {
+	fclose(fp);
+	return 0;
+    }
+    const MinMax framing = skel.findFrame( pointsForFraming, _x, _y, _color );
+    const Zoom zoom( framing, width, height, skel.getZoomFunction() );
+    resetExtraImages( true );
+    const int stepsPerBand = 100;
+    const int pointsPerStep = std::max( 1, posterPoints / stepsPerBand );
+    int maxHit = 0;
+    bool written = true;
+    {
+	Progress progress( _("Building poster"), bands*stepsPerBand );
+	std::vector<int> hits( width );
+	std::vector<float> rgb( colored ? 3*width : 0 );
+	for ( int band = 0; band < bands && written && state == SAVEPOSTER; ++band ) {
+	    const int top = band*bandHeight;
+	    const int h = std::min( bandHeight, height - top );
+	    // every band sees the whole fractal: the points outside of it
+	    // are discarded by the range checking of mem_plot
+	    Zoom bandZoom( zoom );
+	    bandZoom.crop( 0, top );
+	    ImageDensity* image = buildDensityImage( width, h );
+	    skel.setXY( _x, _y, _color );
+	    std::vector<RenderTarget> targets;
+	    addTarget( targets, bandZoom, image );
+	    if ( band == 0 ) {
+		// the extra images get the points of one band
+		for ( size_t i = 0; i < extraImages.size(); ++i ) {
+		    addTarget( targets, extraZoom( i, framing ), extraImages[i] );
+		}
+	    }
+	    for ( int step = 0; step < stepsPerBand && state == SAVEPOSTER; ++step ) {
+		iterBuildPoints( skel, targets, pointsPerStep );
+		progress.setValue( band*stepsPerBand + step );
+	    }
+	    flushTargets( targets );
+	    maxHit = std::max( maxHit, image->getMaxHit() );
+	    for ( int j = 0; j < h && written; ++j ) {
+		image->getRow( j, &hits[0], colored ? &rgb[0] : NULL );
+		written = fwrite( &hits[0], sizeof(int), width, hitFile ) == (size_t)width
+		    && ( !colored
+			 || fwrite( &rgb[0], sizeof(float), 3*width, hitFile ) == (size_t)(3*width) );
+	    }
+	    delete image;
+	}
+    }
+    if ( !written || state != SAVEPOSTER ) { // disk full or cancelled
+	fclose(hitFile);
+	fclose(fp);
+	return 0;
     }
+    rewind(hitFile);
+    PosterRows rows( hitFile, width, colored, maxHit );
+    const int success = ImageGray::writePNG( fp, width, height, colored, rows, description );
+    fclose(hitFile);
+    return success;
 }
+#endif // HAVE_LIBPNG
 
 int
 Engine::drawPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, unsigned long& clock0 ) {
     skelet.setXY( _x, _y, _color );
+    PlotBins* bins = binsFor( image );
     int counter = 0;
     do {
-	iterBuildPoints( skelet, zoom, image, minimalBuiltPoints );
+	iterBuildPoints( skelet, zoom, image, minimalBuiltPoints, bins );
 	counter += minimalBuiltPoints;
     } while ( clock() - clock0 < intervalFrame * timecv );
+    if ( bins != NULL ) {
+	bins->flush();
+    }
     clock0 = clock();
     make_current();
     image.mem_draw();
@@ -183,7 +454,11 @@ Engine::drawPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, unsi
 void
 Engine::drawPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, const int imax ) {
     skelet.setXY( _x, _y, _color );
-    iterBuildPoints( skelet, zoom, image, imax );
+    PlotBins* bins = binsFor( image );
+    iterBuildPoints( skelet, zoom, image, imax, bins );
+    if ( bins != NULL ) {
+	bins->flush();
+    }
     make_current();
     image.mem_draw();
     // we limit the frequence of checking because
@@ -195,13 +470,18 @@ Engine::drawPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, cons
 
 void
 Engine::iterBuildPoints( const Skeleton& skelet, const Zoom& zoom,
-			Image& image, const int imax ) const {
+			Image& image, const int imax, PlotBins* bins ) const {
+    // plots the points at the end of this method. the small images stay in the caches
+    PlotPipeline pipeline( image, prefetchFor( image, bins ) );
     if ( Function::system == LINEAR ) {
 	for ( int i = 1; i <= imax; ++i ) {
 	    skelet.nextPoint( _x, _y, _color );
 	    zoom.toScreen( _x, _y );
-	    image.mem_plot( zoom.screenX, zoom.screenY );
-	    image.mem_coul( zoom.screenX, zoom.screenY, _color );
+	    if ( bins != NULL ) {
+		bins->plot( zoom.screenX, zoom.screenY, _color );
+	    } else {
+		pipeline.plot( zoom.screenX, zoom.screenY, _color );
+	    }
 	}
     } else if ( Function::system == FORMULA || Function::system == SINUSOIDAL ) {
 	// since initial conditions are important, we have to give a new seed to the orbit
@@ -211,8 +491,11 @@ Engine::iterBuildPoints( const Skeleton& skelet, const Zoom& zoom,
 	for ( int i = 1; i <= imax; ++i ) {
 	    skelet.nextPoint( _x, _y, _color );
 	    zoom.toScreen( _x, _y );
-	    image.mem_plot( zoom.screenX, zoom.screenY );
-	    image.mem_coul( zoom.screenX, zoom.screenY, _color );
+	    if ( bins != NULL ) {
+		bins->plot( zoom.screenX, zoom.screenY, _color );
+	    } else {
+		pipeline.plot( zoom.screenX, zoom.screenY, _color );
+	    }
 	    if ( i % 1000 == 0 ) {
 		_x = (float)rand()*2/RAND_MAX - 1;
 		_y = (float)rand()*2/RAND_MAX - 1;
@@ -231,6 +514,154 @@ Engine::iterBuildPoints( const Skeleton& skelet, const Zoom& zoom,
     }
 }
 
+void
+Engine::drawPoints( const Skeleton& skelet, std::vector<RenderTarget>& targets, unsigned long& clock0 ) {
+    skelet.setXY( _x, _y, _color );
+    if ( clockNumber ) {
+	do {
+	    iterBuildPoints( skelet, targets, minimalBuiltPoints );
+	} while ( clock() - clock0 < intervalFrame * timecv );
+    } else {
+	iterBuildPoints( skelet, targets, pointsPerFrame );
+    }
+    flushTargets( targets );
+    clock0 = clock();
+    make_current();
+    targets[0].image->mem_draw();
+    // we limit the frequence of checking because
+    // it slows the program under Windows
+    if ( Fl::ready() ) {
+	Fl::check();
+    }
+}
+
+void
+Engine::iterBuildPoints( const Skeleton& skelet, std::vector<RenderTarget>& targets,
+			 const int imax ) const {
+    if ( Function::system == JULIA ) {
+	// the orbit goes back to the points which fell on the pixels seldom hit in the first target
+	const Zoom& lead = targets[0].zoom;
+	for ( int i = 1; i <= imax; ++i ) {
+	    skelet.nextPoint( _x, _y, _color );
+	    for ( std::vector<RenderTarget>::iterator t = targets.begin(); t != targets.end(); ++t ) {
+		t->zoom.toScreen( _x, _y );
+	    }
+	    lead.julia.handle( _x, _y, targets[0].image->getHit( lead.screenX, lead.screenY ) );
+	    for ( std::vector<RenderTarget>::iterator t = targets.begin(); t != targets.end(); ++t ) {
+		t->image->mem_plot( t->zoom.screenX, t->zoom.screenY );
+		t->image->mem_coul( t->zoom.screenX, t->zoom.screenY, _color );
+	    }
+	}
+	return;
+    }
+    const bool seeded = ( Function::system == FORMULA || Function::system == SINUSOIDAL );
+    if ( seeded ) {
+	// as the other iterBuildPoints
+	_x = (float)rand()*2/RAND_MAX - 1;
+	_y = (float)rand()*2/RAND_MAX - 1;
+	skelet.setXY( _x, _y, _color );
+    }
+    // the points are built by blocks plotted in one target after the
+    // other, so that the bins or the pixels of a target stay in the caches
+    const int blockSize = 1024;
+    float xs[blockSize];
+    float ys[blockSize];
+    float colors[blockSize];
+    for ( int done = 0; done < imax; ) {
+	const int n = std::min( blockSize, imax - done );
+	for ( int k = 0; k < n; ++k ) {
+	    skelet.nextPoint( _x, _y, _color );
+	    xs[k] = _x;
+	    ys[k] = _y;
+	    colors[k] = _color;
+	    if ( seeded && ( done + k + 1 ) % 1000 == 0 ) {
+		_x = (float)rand()*2/RAND_MAX - 1;
+		_y = (float)rand()*2/RAND_MAX - 1;
+		skelet.setXY( _x, _y, _color );
+	    }
+	}
+	done += n;
+	for ( std::vector<RenderTarget>::iterator t = targets.begin(); t != targets.end(); ++t ) {
+	    const Zoom& zoom = t->zoom;
+	    PlotPipeline pipeline( *t->image, prefetchFor( *t->image, t->binned ? &t->bins : NULL ) );
+	    for ( int k = 0; k < n; ++k ) {
+		zoom.toScreen( xs[k], ys[k] );
+		if ( t->binned ) {
+		    t->bins.plot( zoom.screenX, zoom.screenY, colors[k] );
+		} else {
+		    pipeline.plot( zoom.screenX, zoom.screenY, colors[k] );
+		}
+	    }
+	}
+    }
+}
+
+void
+Engine::addTarget( std::vector<RenderTarget>& targets, const Zoom& zoom, Image* image ) const {
+    targets.push_back( RenderTarget( zoom, image ) );
+    RenderTarget& target = targets.back();
+    // as binsFor
+    target.binned = Function::system != JULIA && image->plotW()*image->plotH() >= binningPixels;
+    if ( target.binned ) {
+	target.bins.bind( *image );
+    }
+}
+
+void
+Engine::flushTargets( std::vector<RenderTarget>& targets ) const {
+    for ( std::vector<RenderTarget>::iterator t = targets.begin(); t != targets.end(); ++t ) {
+	if ( t->binned ) {
+	    t->bins.flush();
+	}
+    }
+}
+
+void
+Engine::resetExtraImages( bool build ) {
+    for ( std::vector< Image* >::const_iterator i = extraImages.begin(); i != extraImages.end(); ++i ) {
+	delete *i;
+    }
+    extraImages.clear();
+    extraOffsets.clear();
+    if ( !build ) {
+	return;
+    }
+    std::istringstream sizes( extraSizes );
+    std::string size;
+    while ( sizes >> size ) {
+	int width = 0;
+	int height = 0;
+	int x = 0;
+	int y = 0;
+	const int read = sscanf( size.c_str(), "%dx%d+%d+%d", &width, &height, &x, &y );
+	if ( ( read == 2 || read == 4 ) && width > 0 && height > 0 ) {
+	    extraImages.push_back( buildImage( width, height ) );
+	    extraOffsets.push_back( read == 4 ? std::make_pair( x, y ) : std::make_pair( -1, -1 ) );
+	}
+    }
+}
+
+Zoom
+Engine::extraZoom( const int i, const MinMax& framing ) const {
+    const Image& image = *extraImages[i];
+    if ( extraOffsets[i].first < 0 ) {
+	return Zoom( framing, image.plotW(), image.plotH(), skel.getZoomFunction() );
+    }
+    Zoom zoom( framing, imageSavedWidth, imageSavedHeight, skel.getZoomFunction() );
+    zoom.crop( extraOffsets[i].first, extraOffsets[i].second );
+    return zoom;
+}
+
+PlotBins*
+Engine::binsFor( Image& image ) const {
+    // the julia orbits need the hits immediately
+    if ( Function::system == JULIA || image.plotW()*image.plotH() < binningPixels ) {
+	return NULL;
+    }
+    plotBins.bind( image );
+    return &plotBins;
+}
+
 void
 Engine::resetImage( int w, int h, int wd, int wh, int s ) {
     delete imageLarge;
@@ -240,16 +671,30 @@ Engine::resetImage( int w, int h, int wd, int wh, int s ) {
 Image*
 Engine::buildImage( int w, int h, int wd, int wh, int s ) const {
     if ( trueDensity ) {
-	return new ImageDensity( w, h, colored, wd, wh, s );
+	return buildDensityImage( w, h, wd, wh, s );
     } else {
 	return new ImagePseudoDensity( w, h, colored, wd, wh, s );
     }
 }
 
+ImageDensity*
+Engine::buildDensityImage( int w, int h, int wd, int wh, int s ) const {
+    if ( hitCounters == COMPACT_COUNTERS ) {
+	return new ImageCompactDensity( w, h, colored, wd, wh, s );
+    } else if ( hitCounters == LOG_COUNTERS ) {
+	return new ImageLogDensity( w, h, colored, wd, wh, s );
+    } else if ( hitCounters == SPARSE_COUNTERS ) {
+	return new ImageSparseDensity( w, h, colored, wd, wh, s );
+    } else if ( hitCounters == BRICK_COUNTERS ) {
+	return new ImageBrickDensity( w, h, colored, wd, wh, s );
+    }
+    return new ImageDensity( w, h, colored, wd, wh, s );
+}
+
 void
 Engine::zoom() {
-    const int imagesWidth  = ( state == SAVEMNG ) ? animationSavedWidth : w();
-    const int imagesHeight = ( state == SAVEMNG ) ? animationSavedHeight : h();
+    const int imagesWidth  = savingAnimation() ? animationSavedWidth : w();
+    const int imagesHeight = savingAnimation() ? animationSavedHeight : h();
     Skeleton skelSubframe;
     // we must check that we are not going to zoom inside the zoom function:
     if ( skel.selected() == 0 ) {
@@ -258,14 +703,13 @@ Engine::zoom() {
 	skel.shiftSelectedFunction(1);
     }
     skelSubframe.subframe(skel);
-    Function functionWork;
     const Zoom zoom( skel.findFrame( pointsForFraming, _x, _y, _color ),
 		     imagesWidth, imagesHeight, skel.getZoomFunction(), framesPerCycle );
     for ( std::vector< Image* >::const_iterator i = images.begin(); i != images.end(); ++i ) {
 	delete *i;
     }
     images.clear();
-    for ( int i = 0; i < framesPerCycle; ++i ) {
+    for ( int i = 0; i < framesInMemory( framesPerCycle ); ++i ) {
 	images.push_back( buildImage( imagesWidth, imagesHeight, w(), h() ) );
     }
     int idemo = 1;
@@ -274,30 +718,52 @@ Engine::zoom() {
     const float dilat0 = 1.0/skelSubframe.getFunction().surface();
     const float dilat1 = 1.0/skel.getFunction().surface();
     const float otherDilat = 1.0/(skel.sumSurfaces() - skel.getFunction().surface());
-    while ( idemo <= idemoMax ) {
+    std::vector<Function> views( framesPerCycle );
+    std::vector<int> points( framesPerCycle, pointsPerFrame );
+    for ( int k = 0; k < framesPerCycle; ++k ) {
+	const float rate = (float)k / framesPerCycle;
+	views[k].spiralMix( skel.getFunction(), skelSubframe.getFunction(), rate );
+	views[k].calculateTemp();
+	if ( savingAnimation() ) {
+	    // points(t) = points(0)*(1 + S/s(t) * (1/s(t) - 1/s(0))/(1/s(1) - 1/s(0)) ) 
+	    points[k] = (int)( ( 1.0 + (1/views[k].surface()-dilat0)
+				 / (dilat1-dilat0) * dilat1 / otherDilat
+				   ) * pointsPerFrame );
+	    // to avoid explosion of computation time:
+	    if ( points[k] > 100 * pointsPerFrame ) {
+		points[k] = 100 * pointsPerFrame;
+	    }
+	}
+    }
+    if ( state == SAVEMNG || state == SAVEAPNG ) {
+	// all the frames are in memory: one orbit is enough for all of them
+	zoomFrames( zoom, views, points );
+	if ( !savingAnimation() ) {
+	    // cancelled
+	    return;
+	}
 	for ( int k = 0; k < framesPerCycle; ++k ) {
-	    const float rate = (float)k / framesPerCycle;
-	    functionWork.spiralMix( skel.getFunction(), skelSubframe.getFunction(), rate );
-	    functionWork.calculateTemp();
-	    int pointsToCalculate = pointsPerFrame;
-	    if ( state == SAVEMNG) {	
-		// points(t) = points(0)*(1 + S/s(t) * (1/s(t) - 1/s(0))/(1/s(1) - 1/s(0)) ) 
-		pointsToCalculate = (int)( ( 1.0 + (1/functionWork.surface()-dilat0)
-					     / (dilat1-dilat0) * dilat1 / otherDilat
-					       ) * pointsPerFrame );
-		// to avoid explosion of computation time:
-		if ( pointsToCalculate > 100 * pointsPerFrame ) {
-		    pointsToCalculate = 100 * pointsPerFrame;
-		}
+	    make_current();
+	    frame(k).mem_draw();
+	    frameDone( frame(k) );
+	    if ( Fl::ready() ) {
+		Fl::check();
 	    }
+	}
+	return;
+    }
+    while ( idemo <= idemoMax ) {
+	for ( int k = 0; k < framesPerCycle; ++k ) {
+	    const Function& functionWork = views[k];
+	    const int pointsToCalculate = points[k];
 	    for ( int i = 1; clockNumber || i < pointsToCalculate; ++i ) {
 		skel.nextPoint( _x, _y, _color );
 		float zx = _x;
 		float zy = _y;
 		functionWork.previousPoint( zx, zy, false );
 		zoom.toScreen( zx, zy );
-		images[k]->mem_plot( zoom.screenX, zoom.screenY );
-		images[k]->mem_coul( zoom.screenX, zoom.screenY, _color );
+		frame(k).mem_plot( zoom.screenX, zoom.screenY );
+		frame(k).mem_coul( zoom.screenX, zoom.screenY, _color );
 		if ( clockNumber ) {
 		    if ( i % minimalBuiltPoints == 0 ) {
 			const unsigned long newClock = clock();
@@ -309,18 +775,72 @@ Engine::zoom() {
 		}
 	    }
 	    make_current();
-	    images[k]->mem_draw();
+	    frame(k).mem_draw();
+	    frameDone( frame(k) );
 	    if ( Fl::ready() ) {
 		Fl::check();
 	    }
-	    if ( state != ANIMATION && state != DEMO && state != SAVEMNG ) {
+	    if ( state != ANIMATION && state != DEMO && !savingAnimation() ) {
 	        return;
 	    }
 	}
 	if ( state == DEMO ) {
 	    ++idemo;
 	}
-	if ( state == SAVEMNG ) {
+	if ( savingAnimation() ) {
+	    return;
+	}
+    }
+}
+
+void
+Engine::zoomFrames( const Zoom& zoom, const std::vector<Function>& views,
+		    const std::vector<int>& points ) {
+    const int frames = views.size();
+    const int total = *std::max_element( points.begin(), points.end() );
+    std::vector<MinMax> boxes;
+    for ( int k = 0; k < frames; ++k ) {
+	boxes.push_back( zoom.visible( frame(k).plotW(), frame(k).plotH(), views[k] ) );
+    }
+    // the points are built by blocks plotted in one frame after the other
+    const int blockSize = 1024;
+    float xs[blockSize];
+    float ys[blockSize];
+    float colors[blockSize];
+    const unsigned long clock0 = clock();
+    for ( int done = 0; clockNumber || done < total; ) {
+	const int n = clockNumber ? blockSize : std::min( blockSize, total - done );
+	for ( int p = 0; p < n; ++p ) {
+	    skel.nextPoint( _x, _y, _color );
+	    xs[p] = _x;
+	    ys[p] = _y;
+	    colors[p] = _color;
+	}
+	for ( int k = 0; k < frames; ++k ) {
+	    const MinMax& box = boxes[k];
+	    const Function& view = views[k];
+	    Image& image = frame(k);
+	    const int last = clockNumber ? n : std::min( n, points[k] - done );
+	    for ( int p = 0; p < last; ++p ) {
+		if ( box.xMin() <= xs[p] && xs[p] <= box.xMax()
+		     && box.yMin() <= ys[p] && ys[p] <= box.yMax() ) {
+		    float zx = xs[p];
+		    float zy = ys[p];
+		    view.previousPoint( zx, zy, false );
+		    zoom.toScreen( zx, zy );
+		    image.mem_plot( zoom.screenX, zoom.screenY );
+		    image.mem_coul( zoom.screenX, zoom.screenY, colors[p] );
+		}
+	    }
+	}
+	done += n;
+	if ( clockNumber && clock() - clock0 >= frames * intervalFrame * timecv ) {
+	    break;
+	}
+	if ( Fl::ready() ) {
+	    Fl::check();
+	}
+	if ( !savingAnimation() ) {
 	    return;
 	}
     }
@@ -328,8 +848,8 @@ Engine::zoom() {
 
 void
 Engine::rotation() {
-    const int imagesWidth  = ( state == SAVEMNG ) ? animationSavedWidth : w();
-    const int imagesHeight = ( state == SAVEMNG ) ? animationSavedHeight : h();
+    const int imagesWidth  = savingAnimation() ? animationSavedWidth : w();
+    const int imagesHeight = savingAnimation() ? animationSavedHeight : h();
     Skeleton skelWork = skel;
     std::vector<Zoom> zooms;
     for ( std::vector< Image* >::const_iterator i = images.begin(); i != images.end(); ++i ) {
@@ -341,6 +861,8 @@ Engine::rotation() {
 	skelWork.rotate( 2*M_PI/(2*framesPerCycle) );
 	zooms.push_back( Zoom( minmax, imagesWidth, imagesHeight,
 			       skelWork.getZoomFunction(), framesPerCycle ) );
+    }
+    for ( int i = 0; i < framesInMemory( zooms.size() ); ++i ) {
 	images.push_back( buildImage( imagesWidth, imagesHeight, w(), h() ) );
     }
     int idemo = 1;
@@ -352,20 +874,21 @@ Engine::rotation() {
 	for ( int k = -framesPerCycle; k <= framesPerCycle-1; ++k ) {
 	    if ( clockNumber ) {
 		drawPoints( skelWork, zooms[k+framesPerCycle],
-			    *images[k+framesPerCycle], timer );
+			    frame(k+framesPerCycle), timer );
 	    } else {
 		drawPoints( skelWork, zooms[k+framesPerCycle],
-			    *images[k+framesPerCycle], pointsPerFrame );
+			    frame(k+framesPerCycle), pointsPerFrame );
 	    }
+	    frameDone( frame(k+framesPerCycle) );
 	    skelWork.rotate( 2*M_PI/(2*framesPerCycle) );
-	    if ( state != ANIMATION && state != DEMO && state != SAVEMNG ) {
+	    if ( state != ANIMATION && state != DEMO && !savingAnimation() ) {
 	        return;
 	    }
 	}
 	if ( state == DEMO ) {
 	    ++idemo;
 	}
-	if ( state == SAVEMNG ) {
+	if ( savingAnimation() ) {
 	    return; // break
 	}
     }
@@ -373,8 +896,8 @@ Engine::rotation() {
 
 void
 Engine::transition() {
-    const int imagesWidth  = ( state == SAVEMNG ) ? animationSavedWidth : w();
-    const int imagesHeight = ( state == SAVEMNG ) ? animationSavedHeight : h();
+    const int imagesWidth  = savingAnimation() ? animationSavedWidth : w();
+    const int imagesHeight = savingAnimation() ? animationSavedHeight : h();
     Skeleton skelWork( skel1.size() );
     std::vector<Zoom> zooms;
     for ( std::vector< Image* >::const_iterator i = images.begin(); i != images.end(); ++i ) {
@@ -387,6 +910,8 @@ Engine::transition() {
 	skelWork.weightedMix( skel1, skel2, rate );
 	zooms.push_back( Zoom( minmax, imagesWidth, imagesHeight,
 			       skelWork.getZoomFunction(), framesPerCycle ) );
+    }
+    for ( int i = 0; i < framesInMemory( zooms.size() ); ++i ) {
 	images.push_back( buildImage( imagesWidth, imagesHeight, w(), h() ) );
     }
     int idemo = 1;
@@ -398,17 +923,18 @@ Engine::transition() {
 	    skelWork.weightedMix( skel1, skel2, rate );
 	    const int i = (k > 0)? framesPerCycle - k: k+framesPerCycle;
 	    if ( clockNumber ) {
-		drawPoints( skelWork, zooms[i], *images[i], timer );
+		drawPoints( skelWork, zooms[i], frame(i), timer );
 	    } else {
-		drawPoints( skelWork, zooms[i], *images[i], pointsPerFrame );
+		drawPoints( skelWork, zooms[i], frame(i), pointsPerFrame );
 	    }
-	    if ( state != ANIMATION && state != DEMO && state != SAVEMNG ) {
+	    frameDone( frame(i) );
+	    if ( state != ANIMATION && state != DEMO && !savingAnimation() ) {
 	        return;
 	    }
 	    if ( state == DEMO && idemo == idemoMax && k == 0 ) {
 		return; // break
 	    }
-	    if ( state == SAVEMNG && k == 0 ) {
+	    if ( savingAnimation() && k == 0 ) {
 		return; // break
 	    }
 	}
@@ -418,6 +944,17 @@ Engine::transition() {
     }
 }
 
+void
+Engine::frameDone( Image& image ) {
+    if ( state == SAVEVIDEO ) {
+	if ( !video.add( image ) ) {
+	    // the video can not be written: the calculation stops
+	    state = PREVIEW;
+	}
+	image.mem_clear();
+    }
+}
+
 const MinMax
 Engine::findFrameRotation( const int nbit ) const {
     MinMax minmax;
@@ -20,11 +20,23 @@ USA.
 #define ENGINE_HPP
 
 #include <vector>
+#include <string>
 
 #include <FL/Fl_Double_Window.H>
 
 #include "Skeleton.hpp"
-class Image;
+#include "Image.hpp"
+#include "Checkpoint.hpp"
+#include "PointCloud.hpp"
+#include "Video.hpp"
+
+/// default of Engine::binningPixels. the crossover measured by "glito -b" depends on the caches
+const int defaultBinningPixels = 4096*4096;
+
+/** PlotPipeline is used for the images of at least #prefetchPixels# pixels.
+    Below, prefetching costs more than it saves (see "glito -b")
+*/
+const int prefetchPixels = 2048*1024;
 
 #ifdef WIN32
 const float timecv = 1; // clock() returns milli-seconds
@@ -43,7 +55,12 @@ enum State {
     SAVEBMPB,
     SAVEBMPG,
     SAVEPNG,
-    SAVEMNG
+    SAVEPNG16,
+    SAVEPFM,
+    SAVEMNG,
+    SAVEAPNG,
+    SAVEVIDEO,
+    SAVEPOSTER
 };
 
 /**  variables for Julia orbit to accelerate the calculation
@@ -71,6 +88,15 @@ public:
     /// result is stored in screenX and screenY
     void toScreen( float x, float y ) const;
 
+    /// move the point (x0, y0) of the screen to (0, 0). used to render the bands of a poster
+    void crop( int x0, int y0 ) { cropX += x0; cropY += y0; }
+
+    /** box of the points which fall in an image of size w*h once sent by
+	view.previousPoint then by toScreen. used to skip the points out of
+	the frames of a zoom animation
+    */
+    MinMax visible( int w, int h, const Function& view ) const;
+
     mutable int screenX;
     mutable int screenY;
 
@@ -86,6 +112,12 @@ protected:
     int centerX;
     int centerY;
 
+    /** shift of the screen set by crop, subtracted after the rounding of
+	toScreen: a point is in the same pixel as without crop
+    */
+    int cropX;
+    int cropY;
+
     /**
      * add a border to avoid for some pixel of the fractals to be out of the image.
      * example: 0.96 That means that the fractale is 96% smaller to leave place for
@@ -95,6 +127,24 @@ protected:
 
 };
 
+/** an image calculated from the same orbit as other ones (see
+    Engine::iterBuildPoints): its framing, size and crop are given by
+    #zoom#, its kind by #image#
+*/
+class RenderTarget {
+public:
+    RenderTarget( const Zoom& zoom, Image* image ) : zoom(zoom), image(image), binned(false) {}
+
+    Zoom zoom;
+
+    /// not deleted by the target
+    Image* image;
+
+    /// the points are sorted by #bins# before being plotted if #binned#. see Engine::binningPixels
+    PlotBins bins;
+    bool binned;
+};
+
 class Engine : public Fl_Double_Window {
 public:
     Engine( int cornerX, int cornerY, int w, int h, const char *label = 0 );
@@ -113,9 +163,23 @@ public:
     /// build and draw #image# indefinitely
     void drawLargeView();
 
+#ifdef HAVE_LIBPNG
+    /** build an image of size imageSavedWidth*imageSavedHeight band by band,
+	each band fitting in #posterMemory#, and save it as PNG to #f#.
+	Cancelled, without writing #f#, as soon as #state# is no longer
+	SAVEPOSTER. returns 1 if succeed, 0 if failed or cancelled
+    */
+    int drawPoster( FILE* f, const std::string& description );
+#endif // HAVE_LIBPNG
+
     /// state ( preview, animation, saving, ... )
     State state;
 
+    /// true if the frames of an animation to save are calculated (MNG, APNG or video)
+    bool savingAnimation() const {
+	return state == SAVEMNG || state == SAVEAPNG || state == SAVEVIDEO;
+    }
+
     /// current skeleton
     Skeleton skel;
 
@@ -149,6 +213,14 @@ public:
     /// true if we use ImageDensity and not ImagePseudoDensity
     bool trueDensity;
 
+    /** storage of the counters of the density images. COMPACT_COUNTERS
+	halves the memory of the animations, LOG_COUNTERS divides it by 4,
+	SPARSE_COUNTERS only allocates the parts of the image which are hit,
+	BRICK_COUNTERS stores neighbour pixels close in memory.
+	Can be changed by the user only by modifying the file of parameters
+    */
+    HitCounters hitCounters;
+
     /// true if we use colored ImageDensity
     bool colored;
 
@@ -161,6 +233,67 @@ public:
     int animationSavedHeight;
     //}
 
+    // { posters: images too large for the memory, built by horizontal bands.
+    // Can be changed by the user only by modifying the file of parameters
+    /// number of points calculated for each band
+    int posterPoints;
+    /// memory in MB for the image of a band
+    int posterMemory;
+    // }
+
+    /** the points of the images of at least #binningPixels# pixels are
+	sorted by PlotBins before being plotted. see "glito -b".
+	Can be changed by the user only by modifying the file of parameters
+    */
+    int binningPixels;
+
+    /** number of points calculated between the prefetch of a pixel and
+	its hit for the images between prefetchPixels and binningPixels
+	(see PlotPipeline). 0: no prefetch.
+	Can be changed by the user only by modifying the file of parameters
+    */
+    int prefetchDistance;
+
+    /** the large view and the saved images are calculated #supersampling#
+	times larger in both directions, then reduced (see ImageSupersampled).
+	1: no supersampling. Only for ImageDensity.
+	Can be changed by the user only by modifying the file of parameters
+    */
+    int supersampling;
+
+    /** number of seconds between two checkpoints of the images being
+	saved (see Checkpoint). 0: no checkpoint.
+	Can be changed by the user only by modifying the file of parameters
+    */
+    int checkpointInterval;
+
+    /// file where the checkpoints are written
+    std::string checkpointFile;
+
+    /** sizes of the images calculated from the same orbit as a saved
+	image or a poster, and saved beside it: "160x120 1920x1080". An
+	image "WxH+X+Y" is the part at (X, Y) of the saved image, at its
+	scale; without offset, it shows the whole fractal.
+	Can be changed by the user only by modifying the file of parameters
+    */
+    std::string extraSizes;
+
+    // { point cloud replayed by drawLargeView instead of iterating the skeleton again
+    // (see PointCloud). Can be changed by the user only by modifying the file of parameters
+    /// number of points of the cloud. 0: no cloud
+    int pointCloudPoints;
+    /// true if the points are stored on 16 bits
+    bool pointCloudQuantized;
+    /// file keeping the cloud of the last skeleton. empty: the cloud is only in memory
+    std::string pointCloudFile;
+    // }
+
+    /** read the checkpoint #file#: the next drawLargeView continues its
+	calculation with its skeleton, framing and size.
+	returns false if #file# is not a checkpoint
+    */
+    bool resume( const std::string& file );
+
     bool isColored() const { return colored; }
 
 protected:
@@ -169,12 +302,67 @@ protected:
     */
     std::vector< Image* > images;
 
+    /** video where the frames are written as soon as they are calculated
+	(state SAVEVIDEO): #images# then holds a single image, cleared
+	after each frame
+    */
+    VideoStream video;
+
+    /// number of images of an animation of #frames# frames
+    int framesInMemory( int frames ) const { return state == SAVEVIDEO ? 1 : frames; }
+
+    /** plot the first points[k] points of one orbit of #skel# in the
+	frame #k# of a zoom seen through views[k]. if clockNumber, all the
+	points built during framesPerCycle*intervalFrame go in every frame
+    */
+    void zoomFrames( const Zoom& zoom, const std::vector<Function>& views,
+		     const std::vector<int>& points );
+
+    /// image of the frame #k# of an animation. see video
+    Image& frame( int k ) { return *images[ state == SAVEVIDEO ? 0 : k ]; }
+
+    /// the frame #image# is drawn: written to #video# and cleared if a video is saved
+    void frameDone( Image& image );
+
     /// large view
     Image* imageLarge;
 
+    /// images of the extraSizes calculated with the last saved image or poster
+    std::vector< Image* > extraImages;
+
+    /// offset "+X+Y" of each of the extraImages in the saved image. x < 0: none
+    std::vector< std::pair<int, int> > extraOffsets;
+
+    /// delete the extraImages, then build them empty if #build#
+    void resetExtraImages( bool build );
+
+    /// zoom of the extra image #i# when the saved image has the #framing#
+    Zoom extraZoom( int i, const MinMax& framing ) const;
+
+    /// last checkpoint written, or checkpoint to resume
+    Checkpoint checkpoint;
+
+    /// true if drawLargeView must start from #checkpoint#
+    bool resuming;
+
+    /// points of the orbit of the last skeleton of drawLargeView
+    PointCloud pointCloud;
+
+    /** true if #pointCloud# holds the points of #skel#: if needed, they are
+	read from pointCloudFile or calculated (and written to pointCloudFile).
+	false if there is no cloud: pointCloudPoints is 0 or the orbit is julia
+    */
+    bool readyPointCloud();
+
+    /// copy the hits of imageLarge to #checkpoint# and write it to checkpointFile in the background
+    void writeCheckpoint( const MinMax& framing, int factor );
+
     /// return a new pointer of ImageDensity or ImagePseudoDensity
     Image* buildImage( int w, int h, int wd = -1, int wh = -1, int s = -1 ) const;
 
+    /// return a new pointer of ImageDensity storing its hits according to #hitCounters#
+    ImageDensity* buildDensityImage( int w, int h, int wd = -1, int wh = -1, int s = -1 ) const;
+
     mutable float _x;
     mutable float _y;
     mutable float _color;
@@ -185,8 +373,35 @@ protected:
      */
     int minimalBuiltPoints;
 
-    /// called only by drawPoints(...) and Glito::drawPreview
-    void iterBuildPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, const int imax ) const;
+    /** called only by drawPoints(...) and Glito::drawPreview.
+	if #bins# is not NULL, the points are put in #bins# which must be flushed
+    */
+    void iterBuildPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, const int imax,
+			  PlotBins* bins = NULL ) const;
+
+    /// return #plotBins# bound to #image# or NULL if #image# is too small to use bins
+    PlotBins* binsFor( Image& image ) const;
+
+    /// add #image# seen through #zoom# to #targets#, with bins if #image# is large
+    void addTarget( std::vector<RenderTarget>& targets, const Zoom& zoom, Image* image ) const;
+
+    /** build #imax# points and plot each of them in all the #targets#:
+	the cost of the orbit is shared. The julia orbits are led by the
+	hits of the first target. The bins must then be flushed
+    */
+    void iterBuildPoints( const Skeleton& skelet, std::vector<RenderTarget>& targets,
+			  const int imax ) const;
+
+    /// plot the points waiting in the bins of #targets#
+    void flushTargets( std::vector<RenderTarget>& targets ) const;
+
+    /// prefetch distance of a PlotPipeline plotting in #image# without #bins#
+    int prefetchFor( const Image& image, const PlotBins* bins ) const {
+	return bins == NULL && image.plotW()*image.plotH() >= prefetchPixels ? prefetchDistance : 0;
+    }
+
+    /// kept to reuse its memory
+    mutable PlotBins plotBins;
 
     /// build #imax# points and draw #image#
     void drawPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, const int imax );
@@ -196,6 +411,11 @@ protected:
     */
     int drawPoints( const Skeleton& skelet, const Zoom& zoom, Image& image, unsigned long& clock0 );
 
+    /** build points in all the #targets# during #intervalFrame# if
+	clockNumber, else #pointsPerFrame# points, and draw the first target
+    */
+    void drawPoints( const Skeleton& skelet, std::vector<RenderTarget>& targets, unsigned long& clock0 );
+
 private:
     const MinMax findFrameRotation( int nbit ) const;
 
@@ -47,34 +47,26 @@ SchemaScale::SchemaScale( float cx, float cy, float s
     }
 }
 
-string
-Function::systemToXML( int level ) {
-    string s;
+void
+Function::systemToXML( IS::XMLWriter& xml ) {
     if ( system == SINUSOIDAL ) {
-	s = "sinusoidal";
+	xml.element( "systemType", "sinusoidal" );
     } else if ( system == LINEAR ) {
-	s = "linear";
+	xml.element( "systemType", "linear" );
     } else if ( system == JULIA ) {
-	s = "juliaLinear";
+	xml.element( "systemType", "juliaLinear" );
     } else if ( system == FORMULA ) {
-	IS::ToXML formulasXML(level);
-//	formulasXML.elementI( "parameters", "x1 y1 x2 y2 xc yc" );
-	formulasXML.elementI( "nextX", formulaPoint.getStringX() );
-	formulasXML.elementI( "nextY", formulaPoint.getStringY() );
-	s = IS::ToXML(level).elementIR( "formula", formulasXML.getValue() ).getValue();
-    }
-    IS::ToXML res(level);
-    if ( system == FORMULA ) { 
-	res.elementIR( "systemType", s);
-    } else {
-	res.elementI( "systemType", s);
+	xml.open( "systemType" ).open( "formula" );
+//	xml.element( "parameters", "x1 y1 x2 y2 xc yc" );
+	xml.element( "nextX", formulaPoint.getStringX() );
+	xml.element( "nextY", formulaPoint.getStringY() );
+	xml.close().close();
     }
-    return res.getValue();
 }
 
 void
-Function::systemFromXML( const string& paramXML ) {
-    const string s = IS::ToXML::extractFirst( paramXML, "systemType" );
+Function::systemFromXML( const IS::FromXML::Element& paramXML ) {
+    const string s = paramXML.value( "systemType" );
      if ( s == "sinusoidal" ) {
 	system = SINUSOIDAL;
     } else if ( s == "juliaLinear" ) {
@@ -83,8 +75,8 @@ Function::systemFromXML( const string& paramXML ) {
 	system = LINEAR;
     } else { // formula
 	system = FORMULA;
-	formulaPoint = FormulaPoint( IS::ToXML::extractFirst( paramXML, "nextX" ),
-				     IS::ToXML::extractFirst( paramXML, "nextY" ),
+	formulaPoint = FormulaPoint( paramXML.value( "nextX" ),
+				     paramXML.value( "nextY" ),
 				     "x y x1 y1 x2 y2 xc yc" );
     }
 }
@@ -526,28 +518,26 @@ Function::modified() const {
     return (fabs(x1-1) + fabs(y1) + fabs(x2) + fabs(y2-1) + fabs(xc) + fabs(yc) > 0.0001);
 }
 
-string
-Function::toXML( int level ) const {
-    return IS::ToXML(level)
-	.elementIR( "function", IS::ToXML(level)
-		    .elementI( "x1", x1 )
-		    .elementI( "y1", y1 )
-		    .elementI( "x2", x2 )
-		    .elementI( "y2", y2 )
-		    .elementI( "xc", xc )
-		    .elementI( "yc", yc )
-		    .getValue() )
-	.getValue();
+void
+Function::toXML( IS::XMLWriter& xml ) const {
+    xml.open( "function" )
+	.element( "x1", x1 )
+	.element( "y1", y1 )
+	.element( "x2", x2 )
+	.element( "y2", y2 )
+	.element( "xc", xc )
+	.element( "yc", yc )
+	.close();
 }
 
 void
-Function::fromXML( const string& sXML ) {
-    string Tx1( IS::ToXML::extractFirst( sXML, "x1" ) );
-    string Ty1( IS::ToXML::extractFirst( sXML, "y1" ) );
-    string Tx2( IS::ToXML::extractFirst( sXML, "x2" ) );
-    string Ty2( IS::ToXML::extractFirst( sXML, "y2" ) );
-    string Txc( IS::ToXML::extractFirst( sXML, "xc" ) );
-    string Tyc( IS::ToXML::extractFirst( sXML, "yc" ) );
+Function::fromXML( const IS::FromXML::Element& sXML ) {
+    string Tx1( sXML.value( "x1" ) );
+    string Ty1( sXML.value( "y1" ) );
+    string Tx2( sXML.value( "x2" ) );
+    string Ty2( sXML.value( "y2" ) );
+    string Txc( sXML.value( "xc" ) );
+    string Tyc( sXML.value( "yc" ) );
     x1 = (float)atof(Tx1.c_str());
     y1 = (float)atof(Ty1.c_str());
     x2 = (float)atof(Tx2.c_str());
@@ -20,6 +20,7 @@ USA.
 #define FUNCTION_HPP
 
 #include "Formula.hpp"
+#include "IndentedString.hpp"
 
 /** orthonormal scale
 */
@@ -63,10 +64,10 @@ public:
     /// formulas for computing the image of a point
     static FormulaPoint formulaPoint;
 
-    /// convert the kind of sytem to an XML string
-    static std::string systemToXML( int level = 0 );
+    /// write the kind of sytem to #xml#
+    static void systemToXML( IS::XMLWriter& xml );
 
-    static void systemFromXML( const std::string& paramXML );
+    static void systemFromXML( const IS::FromXML::Element& paramXML );
 
     /// sets x1 to 1, y2 to 1 and others to 0  
     Function();
@@ -84,6 +85,13 @@ public:
 
     void previousPoint( float& x, float& y, bool recalculateDenom = true ) const;
 
+    /// image of x and y by the affine function, whatever the system: inverse of previousPoint
+    void affinePoint( float& x, float& y ) const {
+	const float xbis = x1*x + x2*y + xc;
+	y                = y1*x + y2*y + yc;
+	x = xbis;
+    }
+
     /// determinant of the matrice ((x1,y1) (x2,y2))
     float determinant() const { return x1*y2-y1*x2; }
     
@@ -130,11 +138,11 @@ public:
 
     void printCoordinates( int x, int y ) const;
 
-    /// converts the Function to an XML string  
-    std::string toXML( int level = 0 ) const;
+    /// writes the Function to #xml#
+    void toXML( IS::XMLWriter& xml ) const;
 
     /// retrieves a Function from an XML string  
-    void fromXML( const std::string& sXML );
+    void fromXML( const IS::FromXML::Element& sXML );
 
     /// converts the Function to a string for Fractint  
     std::string toFractint() const;
@@ -25,6 +25,7 @@ USA.
 #endif
 # include <iostream>
 #include <fstream>
+#include <sstream>
  
 #ifndef M_PI
 # define M_PI		3.14159265358979323846	/* pi */
@@ -39,6 +40,7 @@ USA.
 
 #include "IndentedString.hpp"
 #include "Glito.hpp"
+#include "Parallel.hpp"
 
 #ifdef ENABLE_NLS
 # include <libintl.h>
@@ -94,23 +96,22 @@ Snapshot::save( const Image& thumbnail, const string& comment ) const {
     }
 }
 
-string
-Snapshot::toXML( int level = 0 ) const {
-    IS::ToXML in(level);
-    in.elementI( "width", width );
-    in.elementI( "height", height );
-    in.elementI( "iterations", iterations );
-    IS::ToXML res(level);
-    return res.elementIR( "snapshot", in.getValue() ).getValue();
+void
+Snapshot::toXML( IS::XMLWriter& xml ) const {
+    xml.open( "snapshot" )
+	.element( "width", width )
+	.element( "height", height )
+	.element( "iterations", iterations )
+	.close();
 }
 
 void
-Snapshot::fromXML( const string& paramXML ) {
-    const string stringXML = IS::ToXML::extractFirst( paramXML, "snapshot" );
-    if ( !stringXML.empty() ) {
-        width = atoi(IS::ToXML::extractFirst( stringXML, "width" ).c_str());
-	height = atoi(IS::ToXML::extractFirst( stringXML, "height" ).c_str());
-	iterations = atoi(IS::ToXML::extractFirst( stringXML, "iterations" ).c_str());
+Snapshot::fromXML( const IS::FromXML::Element& paramXML ) {
+    const IS::FromXML::Element snapshotXML = paramXML.first( "snapshot" );
+    if ( !snapshotXML.text().empty() ) {
+        width = atoi(snapshotXML.value( "width" ).c_str());
+	height = atoi(snapshotXML.value( "height" ).c_str());
+	iterations = atoi(snapshotXML.value( "iterations" ).c_str());
     }
 }
 
@@ -137,6 +138,27 @@ Glito::saveSnapshot() {
         fl_alert( _("Saving PNG file failed.") );
     }
 }
+
+void
+Glito::savePoster() {
+    const char* p = fl_file_chooser( _("Pick a file"), "*.png", "*.png" );
+    if ( p != NULL ) {
+	FILE *fp = fopen( p , "wb" );
+	const string description = skel.toXML();
+	state = SAVEPOSTER;
+	if ( fp == NULL || !drawPoster( fp, description ) ) {
+	    if ( state == SAVEPOSTER ) {
+		fl_alert( _("Saving PNG file failed.") );
+	    } else { // cancelled
+		remove( p );
+	    }
+	} else {
+	    saveExtraImages( SAVEPNG, p, description );
+	}
+	resetExtraImages( false );
+	state = PREVIEW;
+    }
+}
 #endif // HAVE_LIBPNG
 
 Glito::Glito( int cornerX, int cornerY, int w, int h, const char *label )
@@ -144,7 +166,8 @@ Glito::Glito( int cornerX, int cornerY, int w, int h, const char *label )
       rotationShift(0.05),
       closeEdge(0.6), previewSize(0.4),
       intervalMotionDetection(40),
-      mouseRotDil(false),
+      mouseRotDil(false), hdrLinear(false), randomSeed(0), mngDelta(false),
+      videoFormat(VideoStream::Y4M), videoDemoCycles(4),
 #ifdef HAVE_LIBPNG
       snapshot(),
 #endif // HAVE_LIBPNG
@@ -193,28 +216,42 @@ Glito::startSave( const Image::imageFormat format, const int anim ) {
     } else if ( format == Image::PNG ) {
 	state = SAVEPNG;
 	drawLargeView();
-    } else if ( format == Image::MNG ) {
-	state = SAVEMNG;
+    } else if ( format == Image::PNG16 ) {
+	state = SAVEPNG16;
+	drawLargeView();
+    } else if ( format == Image::PFM ) {
+	state = SAVEPFM;
+	drawLargeView();
+    } else if ( format == Image::VIDEO ) {
+	saveVideo( anim );
+    } else if ( format == Image::MNG || format == Image::APNG ) {
+	state = ( format == Image::MNG ) ? SAVEMNG : SAVEAPNG;
         make_current();
 	fl_color(FL_DARK3);
 	fl_rectf( 0, 0, w(), h() );
 	needRedraw = true;
 	if ( anim == 0 ) {
 	    zoom();
-	    save( state, IS::ToXML().elementIR( "zoom", skel.toXML(0,true) ).getValue() );
+	    IS::XMLWriter xml;
+	    xml.open( "zoom" );
+	    skel.toXML( xml, true );
+	    save( state, xml.close().getValue() );
 	} else if ( anim == 1 ) {
 	    transition();
 	    for ( int im = images.size()-1; im >= 0; --im ) {
 		images.push_back( new Image( *images[im] ) );
 	    } 
-	    IS::ToXML skeletons;
-	    // split because IS::ToXML().add().add().getValue() gives seg fault !
-	    skeletons.add( skel1.toXML() ).add( skel2.toXML() );
-	    save( state, IS::ToXML().elementIR( "transition",
-						skeletons.getValue() ).getValue() );
+	    IS::XMLWriter xml;
+	    xml.open( "transition" );
+	    skel1.toXML( xml );
+	    skel2.toXML( xml );
+	    save( state, xml.close().getValue() );
 	} else {
 	    rotation();
-	    save( state, IS::ToXML().elementIR( "rotation", skel.toXML(0,true) ).getValue() );
+	    IS::XMLWriter xml;
+	    xml.open( "rotation" );
+	    skel.toXML( xml, true );
+	    save( state, xml.close().getValue() );
 	}
     }
 #ifdef DEBUG
@@ -224,6 +261,44 @@ Glito::startSave( const Image::imageFormat format, const int anim ) {
 #endif
 }
 
+void
+Glito::saveVideo( const int anim ) {
+    string target = videoCommand;
+    if ( target.empty() ) {
+	const char* extension = ( videoFormat == VideoStream::Y4M ) ? "*.y4m" : "*.rgb";
+	const char* p = fl_file_chooser( _("Pick a file"), extension, extension );
+	if ( p == NULL ) {
+	    return;
+	}
+	target = p;
+    }
+    if ( !video.open( target, videoFormat, animationSavedWidth, animationSavedHeight,
+		      colored, intervalFrame ) ) {
+	video.close();
+	fl_alert( _("Saving video failed.") );
+	return;
+    }
+    state = SAVEVIDEO;
+    make_current();
+    fl_color(FL_DARK3);
+    fl_rectf( 0, 0, w(), h() );
+    needRedraw = true;
+    if ( anim == 0 ) {
+	zoom();
+    } else if ( anim == 1 ) {
+	transition();
+    } else if ( anim == 2 ) {
+	rotation();
+    } else {
+	demonstration();
+    }
+    // the space bar stops the calculation: the frames already calculated are kept
+    if ( !video.close() ) {
+	fl_alert( _("Saving video failed.") );
+    }
+    state = PREVIEW;
+}
+
 void
 Glito::resize( int XX, int YY, int WW, int HH ) {
     if ( WW != w() || HH != h() ) {
@@ -242,6 +317,35 @@ Glito::setColored( bool c ) {
     resetSmallImage( w(), h() );
 }
 
+void
+Glito::resumeCheckpoint( const string& file ) {
+    if ( !resume( file ) ) {
+	fl_alert( _("Failed to open \"%s\"."), file.c_str() );
+	return;
+    }
+    setColored( colored );
+    setSystemType();
+#ifdef HAVE_LIBPNG
+    startSave( Image::PNG );
+#else
+    startSave( Image::PGM );
+#endif // HAVE_LIBPNG
+}
+
+void
+Glito::recolor() {
+    make_current();
+    if ( state == PREVIEW ) {
+	drawSchema();
+	if ( !smallImage->remap() ) {
+	    needRedraw = true;
+	}
+    } else if ( state == LARGEVIEW && imageLarge != NULL ) {
+	// otherwise the next points only have the new colors
+	imageLarge->remap();
+    }
+}
+
 void
 Glito::demonstration() {
     int counter = 0;
@@ -251,7 +355,7 @@ Glito::demonstration() {
 	skel.randomForDemo();
     }
     Function::system = (systemType)((Function::system)%3);
-    while ( state == DEMO ) {
+    while ( state == DEMO || ( state == SAVEVIDEO && counter < videoDemoCycles ) ) {
 	rotation();
 	if ( Function::system == LINEAR ) {
 	    zoom();
@@ -290,8 +394,18 @@ Glito::getState() const {
 	return "SaveBMP Gray";
     case ( SAVEPNG ) :
 	return "SavePNG Gray";
+    case ( SAVEPNG16 ) :
+	return "SavePNG 16 bits";
+    case ( SAVEPFM ) :
+	return "SavePFM";
     case ( SAVEMNG ) :
 	return "SaveMNG Gray";
+    case ( SAVEAPNG ) :
+	return "SaveAPNG";
+    case ( SAVEVIDEO ) :
+	return "SaveVideo";
+    case ( SAVEPOSTER ) :
+	return "SavePoster";
     default:
 	cerr << "State unknown. Code: " << state <<".\n";
 	return "";
@@ -305,8 +419,10 @@ Glito::save( const State saveState, const string& description ) {
 //    assert ( !image->empty() );
     if ( saveState == SAVEPGM ) {
 	p = fl_file_chooser( _("Pick a file"), "*.pgm", "*.pgm" );
-    } else if ( saveState == SAVEPNG ) {
+    } else if ( saveState == SAVEPNG || saveState == SAVEPNG16 || saveState == SAVEAPNG ) {
 	p = fl_file_chooser( _("Pick a file"), "*.png", "*.png" );
+    } else if ( saveState == SAVEPFM ) {
+	p = fl_file_chooser( _("Pick a file"), "*.pfm", "*.pfm" );
     } else if ( saveState == SAVEMNG ) {
 	p = fl_file_chooser( _("Pick a file"), "*.mng", "*.mng" );
     } else if ( saveState == SAVEBMPB || saveState == SAVEBMPG ) {
@@ -315,22 +431,16 @@ Glito::save( const State saveState, const string& description ) {
 	return;
     }
     if ( p != NULL ) {
-	if ( saveState == SAVEPGM ) {
-	    std::ofstream f( p );
-	    imageLarge->save( f, Image::PGM );
-	} else if ( saveState == SAVEBMPB ) {
-	    std::ofstream f( p );
-	    imageLarge->save( f, Image::BMPB );
-	} else if ( saveState == SAVEBMPG ) {
-	    std::ofstream f( p );
-	    imageLarge->save( f, Image::BMPG );
+	if ( saveState <= SAVEPFM ) {
+	    saveImage( *imageLarge, saveState, p, description );
+	    saveExtraImages( saveState, p, description );
 	}
 #ifdef HAVE_LIBPNG
-	else if ( saveState == SAVEPNG ) {
+	else if ( saveState == SAVEAPNG ) {
 	    FILE *fp = fopen( p , "wb" );
 	    if ( fp != NULL ) {
-		if ( !imageLarge->savePNG( fp, description ) ) {
-		    fl_alert( _("Saving PNG file failed.") );
+		if ( !ImageGray::saveAPNG( images, fp, intervalFrame, description ) ) {
+		    fl_alert( _("Saving APNG file failed.") );
 		}
 	    }
 	}
@@ -339,16 +449,76 @@ Glito::save( const State saveState, const string& description ) {
 	else if ( saveState == SAVEMNG ) {
 	    FILE *fp = fopen( p , "wb" );
 	    if ( fp != NULL ) {
-		if ( !ImageGray::saveMNG( images, fp, 1000/intervalFrame, description ) ) {
+		if ( !ImageGray::saveMNG( images, fp, 1000/intervalFrame, description, mngDelta ) ) {
 		    fl_alert( _("Saving MNG file failed.") );
 		}
 	    }
 	}
 #endif
     }
+    resetExtraImages( false );
     state = PREVIEW;
 }
 
+void
+Glito::saveImage( const Image& image, const State saveState, const string& file,
+		  const string& description ) const {
+    if ( saveState == SAVEPGM ) {
+	std::ofstream f( file.c_str() );
+	image.save( f, Image::PGM );
+    } else if ( saveState == SAVEBMPB ) {
+	std::ofstream f( file.c_str() );
+	image.save( f, Image::BMPB );
+    } else if ( saveState == SAVEBMPG ) {
+	std::ofstream f( file.c_str() );
+	image.save( f, Image::BMPG );
+    } else if ( saveState == SAVEPFM ) {
+	FILE *fp = fopen( file.c_str() , "wb" );
+	if ( fp != NULL ) {
+	    if ( !image.saveHDR( fp, Image::PFM, hdrLinear, description ) ) {
+		fl_alert( _("Saving PFM file failed. It needs the true density.") );
+	    }
+	}
+    }
+#ifdef HAVE_LIBPNG
+    else if ( saveState == SAVEPNG ) {
+	FILE *fp = fopen( file.c_str() , "wb" );
+	if ( fp != NULL ) {
+	    if ( !image.savePNG( fp, description ) ) {
+		fl_alert( _("Saving PNG file failed.") );
+	    }
+	}
+    }
+    else if ( saveState == SAVEPNG16 ) {
+	FILE *fp = fopen( file.c_str() , "wb" );
+	if ( fp != NULL ) {
+	    if ( !image.saveHDR( fp, Image::PNG16, hdrLinear, description ) ) {
+		fl_alert( _("Saving PNG file failed. It needs the true density.") );
+	    }
+	}
+    }
+#endif
+}
+
+void
+Glito::saveExtraImages( const State saveState, const string& file, const string& description ) const {
+    // "dir/name.png" -> "dir/name-160x120.png"
+    string::size_type dot = file.rfind( '.' );
+    const string::size_type slash = file.find_last_of( "/\\" );
+    if ( dot == string::npos || ( slash != string::npos && dot < slash ) ) {
+	dot = file.size();
+    }
+    for ( size_t i = 0; i < extraImages.size(); ++i ) {
+	std::ostringstream name;
+	name << file.substr( 0, dot ) << '-' << extraImages[i]->w() << 'x' << extraImages[i]->h();
+	if ( extraOffsets[i].first >= 0 ) {
+	    name << '+' << extraOffsets[i].first << '+' << extraOffsets[i].second;
+	}
+	name << file.substr( dot );
+	saveImage( *extraImages[i], saveState, name.str(), description );
+    }
+}
+
 void
 Glito::drawSchema() const {
     fl_color( ImageGray::background.isBlack() ? FL_DARK2 : FL_LIGHT1 );
@@ -433,8 +603,8 @@ Glito::handle( int event ) {
 	    make_current();
 	    drawSchema();
 	    smallImage->mem_draw();
-	} else if ( state >= SAVEPGM && state <= SAVEMNG ) {
-  	    if ( state == SAVEMNG && (animationSavedWidth < w() || animationSavedHeight < h()) 
+	} else if ( state >= SAVEPGM && state <= SAVEVIDEO ) {
+  	    if ( savingAnimation() && (animationSavedWidth < w() || animationSavedHeight < h()) 
 		 || (imageSavedWidth < w() || imageSavedHeight < h()) ) {
 	        make_current();
 		fl_color(FL_DARK3);
@@ -477,7 +647,7 @@ Glito::handle( int event ) {
 		if ( state == CALIBRATE ) {
 		    return 1;
 		}
-	        if ( state >= SAVEPGM && state <= SAVEPNG ) {
+	        if ( state >= SAVEPGM && state <= SAVEPFM ) {
 		    save( state, skel.toXML() );		    
 		}
 		state = PREVIEW;
@@ -680,11 +850,11 @@ Glito::setSystemType() {
     setSchemaScale( w(), h() ); // because schemaScale depends on systemType
     Fl_Menu_Bar* m = (Fl_Menu_Bar*)parent()->child(0);
 #ifdef HAVE_LIBPNG
-    const int shift = 3;
+    const int shift = 5;
 #else
     const int shift = 0;
 #endif
-    const int begin = 33;
+    const int begin = 35;
     m->mode( begin + 0 + shift, FL_MENU_RADIO );
     m->mode( begin + 1 + shift, FL_MENU_RADIO );
     m->mode( begin + 2 + shift, FL_MENU_RADIO );
@@ -698,79 +868,198 @@ Glito::setSystemType() {
 
 void
 Glito::readParameters( const string& paramXML ) {
-    setCloseEdge( atof(IS::ToXML::extractFirst( paramXML, "closeEdge" ).c_str()) );
-    setPreviewSize( atof(IS::ToXML::extractFirst( paramXML, "previewSize" ).c_str()) );
-    pointsForFraming = atoi(IS::ToXML::extractFirst( paramXML, "pointsForFraming" ).c_str());
-    animationFraming = atof(IS::ToXML::extractFirst( paramXML, "animationFraming" ).c_str());
-    minimalBuiltPoints = atoi(IS::ToXML::extractFirst( paramXML, "minimalBuiltPoints" ).c_str());
-    pointsPerFrame = atoi(IS::ToXML::extractFirst( paramXML, "pointsPerFrame" ).c_str());
-    intervalFrame = atoi(IS::ToXML::extractFirst( paramXML, "intervalFrame" ).c_str());
+    const IS::FromXML xml( paramXML );
+    const IS::FromXML::Element param = xml.root();
+    setCloseEdge( atof(param.value( "closeEdge" ).c_str()) );
+    setPreviewSize( atof(param.value( "previewSize" ).c_str()) );
+    pointsForFraming = atoi(param.value( "pointsForFraming" ).c_str());
+    animationFraming = atof(param.value( "animationFraming" ).c_str());
+    minimalBuiltPoints = atoi(param.value( "minimalBuiltPoints" ).c_str());
+    pointsPerFrame = atoi(param.value( "pointsPerFrame" ).c_str());
+    intervalFrame = atoi(param.value( "intervalFrame" ).c_str());
     intervalMotionDetection =
-	atoi(IS::ToXML::extractFirst( paramXML, "intervalMotionDetection" ).c_str());
-    rotationShift = atof(IS::ToXML::extractFirst( paramXML, "rotationShift" ).c_str());
-    imageSavedWidth = atoi(IS::ToXML::extractFirst( paramXML, "imageSavedWidth" ).c_str());
-    imageSavedHeight = atoi(IS::ToXML::extractFirst( paramXML, "imageSavedHeight" ).c_str());
+	atoi(param.value( "intervalMotionDetection" ).c_str());
+    rotationShift = atof(param.value( "rotationShift" ).c_str());
+    imageSavedWidth = atoi(param.value( "imageSavedWidth" ).c_str());
+    imageSavedHeight = atoi(param.value( "imageSavedHeight" ).c_str());
     {
         // to stay compatible with 1.0 param files without animationSavedWidth
-        const int cand = atoi(IS::ToXML::extractFirst( paramXML, "animationSavedWidth" ).c_str());
+        const int cand = atoi(param.value( "animationSavedWidth" ).c_str());
 	if ( cand ) {
 	    animationSavedWidth = cand;
 	}
     }
     {
-        const int cand = atoi(IS::ToXML::extractFirst( paramXML, "animationSavedHeight" ).c_str());
+        const int cand = atoi(param.value( "animationSavedHeight" ).c_str());
 	if ( cand ) {
 	    animationSavedHeight = cand;
 	}
     }
-    framesPerCycle = atoi(IS::ToXML::extractFirst( paramXML, "framesPerCycle" ).c_str());
+    {
+        const int cand = atoi(param.value( "posterPoints" ).c_str());
+	if ( cand > 0 ) {
+	    posterPoints = cand;
+	}
+    }
+    {
+        const int cand = atoi(param.value( "posterMemory" ).c_str());
+	if ( cand > 0 ) {
+	    posterMemory = cand;
+	}
+    }
+    {
+        const int cand = atoi(param.value( "binningPixels" ).c_str());
+	if ( cand > 0 ) {
+	    binningPixels = cand;
+	}
+    }
+    {
+        const string cand = param.value( "prefetchDistance" );
+	if ( !cand.empty() ) {
+	    prefetchDistance = std::min( std::max( atoi( cand.c_str() ), 0 ),
+					 (int)PlotPipeline::maxDistance );
+	}
+    }
+    {
+        const int cand = atoi(param.value( "supersampling" ).c_str());
+	if ( cand > 0 ) {
+	    supersampling = std::min( cand, (int)ImageSupersampled::maxFactor );
+	}
+    }
+    Parallel::setThreads( atoi(param.value( "threads" ).c_str()) );
+    {
+        const string cand = param.value( "checkpointInterval" );
+	if ( !cand.empty() ) {
+	    checkpointInterval = std::max( atoi( cand.c_str() ), 0 );
+	}
+    }
+    {
+        const string cand = param.value( "checkpointFile" );
+	if ( !cand.empty() ) {
+	    checkpointFile = cand;
+	}
+    }
+    pointCloudPoints = std::max( atoi(param.value( "pointCloudPoints" ).c_str()), 0 );
+    pointCloudQuantized = param.value( "pointCloudQuantized" ) == "true";
+    pointCloudFile = param.value( "pointCloudFile" );
+    extraSizes = param.value( "extraSizes" );
+    // built again with the new parameters
+    pointCloud.clear();
+    ImageDensity::densityFilter.setMaxRadius(
+	atoi(param.value( "densityRadius" ).c_str())
+	);
+    ImageDensity::densityFilter.setCurve(
+	atof(param.value( "densityCurve" ).c_str())
+	);
+    framesPerCycle = atoi(param.value( "framesPerCycle" ).c_str());
     ImagePseudoDensity::pseudoDensity.setLogProbaHitMax(
-	atof( IS::ToXML::extractFirst( paramXML, "logProbaHitMax" ).c_str() )
+	atof( param.value( "logProbaHitMax" ).c_str() )
 	);
-    clockNumber = IS::ToXML::extractFirst( paramXML, "clockNumber" ) == "true";
+    clockNumber = param.value( "clockNumber" ) == "true";
     ImageGray::background.setBlack(
-	IS::ToXML::extractFirst( paramXML, "blackBackground" ) == "true"
+	param.value( "blackBackground" ) == "true"
 	);
     ImageGray::transparency.setTransparencyFromXML(
-	IS::ToXML::extractFirst( paramXML, "transparency" )
+	param.value( "transparency" )
+	);
+    trueDensity = param.value( "trueDensity" ) == "true";
+    hdrLinear = param.value( "hdrLinear" ) == "true";
+    {
+        const string cand = param.value( "pngLevel" );
+	if ( !cand.empty() ) {
+	    ImageGray::pngCompression.setLevel( atoi( cand.c_str() ) );
+	}
+    }
+    ImageGray::pngCompression.setFilterFromXML(
+	param.value( "pngFilter" )
 	);
-    trueDensity = IS::ToXML::extractFirst( paramXML, "trueDensity" ) == "true";
+    {
+        const string cand = param.value( "parallelPng" );
+	if ( !cand.empty() ) {
+	    ImageGray::pngCompression.setParallel( cand == "true" );
+	}
+    }
+    randomSeed = atoi(param.value( "randomSeed" ).c_str());
+    if ( randomSeed != 0 ) {
+	srand( randomSeed );
+    }
+    mngDelta = param.value( "mngDelta" ) == "true";
+    videoFormat = VideoStream::formatFromXML( param.value( "videoFormat" ) );
+    videoCommand = param.value( "videoCommand" );
+    {
+        const int cand = atoi(param.value( "videoDemoCycles" ).c_str());
+	if ( cand > 0 ) {
+	    videoDemoCycles = cand;
+	}
+    }
+    hitCounters = ImageDensity::countersFromXML(
+	param.value( "hitCounters" )
+	);
+    {
+        const float cand = atof(param.value( "morrisBase" ).c_str());
+	if ( cand > 1 ) {
+	    ImageLogDensity::morrisCounter.setBase( cand );
+	}
+    }
     resetImage( w(), h() );
     resetSmallImage( w(), h() );
-    Function::systemFromXML( paramXML );
+    Function::systemFromXML( param );
 #ifdef HAVE_LIBPNG
-    snapshot.fromXML( paramXML );
+    snapshot.fromXML( param );
 #endif // HAVE_LIBPNG
     setSystemType();
 }
 
-string
-Glito::parametersToXML( const int level ) const {
-    return IS::ToXML(level)
-	.elementI( "frameWidth", w() )
-	.elementI( "frameHeight", h() )
-	.elementI( "closeEdge", closeEdge )
-	.elementI( "previewSize", previewSize )
-	.elementI( "pointsForFraming", pointsForFraming )
-	.elementI( "animationFraming", animationFraming )
-	.elementI( "minimalBuiltPoints", minimalBuiltPoints )
-	.elementI( "pointsPerFrame", pointsPerFrame )
-	.elementI( "intervalFrame", intervalFrame )
-	.elementI( "intervalMotionDetection", intervalMotionDetection )
-	.elementI( "rotationShift", rotationShift )
-	.elementI( "imageSavedWidth", imageSavedWidth )
-	.elementI( "imageSavedHeight", imageSavedHeight )
-	.elementI( "animationSavedWidth", animationSavedWidth )
-	.elementI( "animationSavedHeight", animationSavedHeight )
-	.elementI( "framesPerCycle", framesPerCycle )
-	.elementI( "logProbaHitMax", ImagePseudoDensity::pseudoDensity.getLogProbaHitMax() )
-	.elementI( "clockNumber", clockNumber )
-	.elementI( "blackBackground", ImageGray::background.isBlack() )
-	.elementI( "transparency", ImageGray::transparency.transparencyToXML() )
-	.elementI( "trueDensity", trueDensity )
-	.add( Function::systemToXML(level) )
+void
+Glito::parametersToXML( IS::XMLWriter& xml ) const {
+    xml.element( "frameWidth", w() )
+	.element( "frameHeight", h() )
+	.element( "closeEdge", closeEdge )
+	.element( "previewSize", previewSize )
+	.element( "pointsForFraming", pointsForFraming )
+	.element( "animationFraming", animationFraming )
+	.element( "minimalBuiltPoints", minimalBuiltPoints )
+	.element( "pointsPerFrame", pointsPerFrame )
+	.element( "intervalFrame", intervalFrame )
+	.element( "intervalMotionDetection", intervalMotionDetection )
+	.element( "rotationShift", rotationShift )
+	.element( "imageSavedWidth", imageSavedWidth )
+	.element( "imageSavedHeight", imageSavedHeight )
+	.element( "animationSavedWidth", animationSavedWidth )
+	.element( "animationSavedHeight", animationSavedHeight )
+	.element( "posterPoints", posterPoints )
+	.element( "posterMemory", posterMemory )
+	.element( "binningPixels", binningPixels )
+	.element( "prefetchDistance", prefetchDistance )
+	.element( "supersampling", supersampling )
+	.element( "threads", Parallel::threadsSetting() )
+	.element( "checkpointInterval", checkpointInterval )
+	.element( "checkpointFile", checkpointFile )
+	.element( "pointCloudPoints", pointCloudPoints )
+	.element( "pointCloudQuantized", pointCloudQuantized )
+	.element( "pointCloudFile", pointCloudFile )
+	.element( "extraSizes", extraSizes )
+	.element( "densityRadius", ImageDensity::densityFilter.getMaxRadius() )
+	.element( "densityCurve", ImageDensity::densityFilter.getCurve() )
+	.element( "framesPerCycle", framesPerCycle )
+	.element( "logProbaHitMax", ImagePseudoDensity::pseudoDensity.getLogProbaHitMax() )
+	.element( "clockNumber", clockNumber )
+	.element( "blackBackground", ImageGray::background.isBlack() )
+	.element( "transparency", ImageGray::transparency.transparencyToXML() )
+	.element( "trueDensity", trueDensity )
+	.element( "hdrLinear", hdrLinear )
+	.element( "pngLevel", ImageGray::pngCompression.getLevel() )
+	.element( "pngFilter", ImageGray::pngCompression.filterToXML() )
+	.element( "parallelPng", ImageGray::pngCompression.isParallel() )
+	.element( "randomSeed", randomSeed )
+	.element( "mngDelta", mngDelta )
+	.element( "videoFormat", VideoStream::formatToXML( videoFormat ) )
+	.element( "videoCommand", videoCommand )
+	.element( "videoDemoCycles", videoDemoCycles )
+	.element( "hitCounters", ImageDensity::countersToXML(hitCounters) )
+	.element( "morrisBase", ImageLogDensity::morrisCounter.getBase() );
+    Function::systemToXML( xml );
 #ifdef HAVE_LIBPNG
-      	.add( snapshot.toXML(level) )
+    snapshot.toXML( xml );
 #endif // HAVE_LIBPNG
-	.getValue();
 }
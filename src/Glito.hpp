@@ -47,9 +47,9 @@ public:
 
     int getIterations() const { return iterations; }
 
-    string toXML( int level ) const;
+    void toXML( IS::XMLWriter& xml ) const;
 
-    void fromXML( const string& paramXML );
+    void fromXML( const IS::FromXML::Element& paramXML );
 
 private:
     /// directory where are saved the snapshots
@@ -79,9 +79,15 @@ public:
     /// launch the computation
     void startSave( const Image::imageFormat format, const int anim = 0 );
 
-    /// automatic demo
+    /// automatic demo. With the state SAVEVIDEO, videoDemoCycles cycles are saved
     void demonstration();
 
+    /** calculate the animation #anim# (0 zoom, 1 transition, 2 rotation,
+	3 demo) and write its frames at once to videoCommand or to a file
+	chosen by the user (see VideoStream)
+    */
+    void saveVideo( int anim );
+
     /// build and draw #smallImage# indefinitely
     void drawPreview();
 
@@ -103,9 +109,11 @@ public:
 
     void readParameters( const std::string& paramXML );
 
-    std::string parametersToXML( const int level = 0 ) const;
+    void parametersToXML( IS::XMLWriter& xml ) const;
 
-    /// ask the user for the name. The format is defined by #state#
+    /** ask the user for the name. The format is defined by #state#.
+	The extraImages are saved beside the image
+    */
     void save( const State state, const std::string& description );
 
     /// change the menubar and schemaScale to reflect Function::system
@@ -142,6 +150,33 @@ public:
     /// true if the mouse can rotate or dilate a parallelogram
     bool mouseRotDil;
 
+    /** true if the 16 bits PNG and PFM images keep the density linear
+	instead of tone mapping it (see Image::saveHDR).
+	Can be changed by the user only by modifying the file of parameters
+    */
+    bool hdrLinear;
+
+    /** seed of the random numbers, set when the parameters are read. 0:
+	not set. The computers sharing a calculation (see glito-merge)
+	need different seeds.
+	Can be changed by the user only by modifying the file of parameters
+    */
+    int randomSeed;
+
+    /** true if the frames of the MNG animations only hold the pixels
+	changed since the previous frame (see ImageGray::saveMNG).
+	Can be changed by the user only by modifying the file of parameters
+    */
+    bool mngDelta;
+
+    // { videos (see saveVideo). Can be changed by the user only by modifying the file of parameters
+    VideoStream::Format videoFormat;
+    /// command receiving the video on its standard input. empty: a file is asked
+    std::string videoCommand;
+    /// cycles of rotation, zoom and transition of a demo saved as video
+    int videoDemoCycles;
+    // }
+
     void resetSmallImage( int width, int height ) {
 	delete smallImage;
 	smallImage = buildImage( (int)(previewSize*width), (int)(previewSize*height) );
@@ -156,9 +191,20 @@ public:
     void setSnapshotPath();
 
     void saveSnapshot();
+
+    /// build the image to save by bands and save it as PNG. see Engine::drawPoster
+    void savePoster();
 #endif // HAVE_LIBPNG
 
     void setColored( bool c );//coul
+
+    /// continue the calculation of the image saved in the checkpoint #file#
+    void resumeCheckpoint( const string& file );
+
+    /** draw the current image again after a change of the color map or of
+	the background, without calculating it again if it keeps its hits
+    */
+    void recolor();
   
     /// true if skeleton has been modified and drawPreview() must be called again
     bool needRedraw;
@@ -211,6 +257,15 @@ protected:
 
     /// call drawPreview() when state is PREVIEW
     void drawHandler();
+
+    /// save #image# to #file# in the format of #saveState# (SAVEPGM to SAVEPFM)
+    void saveImage( const Image& image, const State saveState, const string& file,
+		    const string& description ) const;
+
+    /** save each of the extraImages to #file# with its size and offset
+	added to the name: "name-160x120.png", "name-400x300+800+600.png"
+    */
+    void saveExtraImages( const State saveState, const string& file, const string& description ) const;
     
 };
 
@@ -0,0 +1,89 @@
+// glito/GzFile.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#include <cstdio>
+// rename, remove
+#include <cstring>
+#include <vector>
+
+#include "GzFile.hpp"
+
+namespace {
+    /// gzwrite and gzread take unsigned ints: the tables are written by pieces
+    const unsigned int piece = 1 << 24;
+}
+
+gzFile
+GzFile::create( const std::string& file ) {
+    const std::string temporary = file + ".tmp";
+    return gzopen( temporary.c_str(), "wb1" );
+}
+
+int
+GzFile::commit( gzFile f, const std::string& file, const bool written ) {
+    const std::string temporary = file + ".tmp";
+    if ( gzclose( f ) != Z_OK || !written
+	 || rename( temporary.c_str(), file.c_str() ) != 0 ) {
+	remove( temporary.c_str() );
+	return 0;
+    }
+    return 1;
+}
+
+bool
+GzFile::write( gzFile f, const void* data, size_t size ) {
+    const char* p = (const char*)data;
+    while ( size > 0 ) {
+	const unsigned int n = size < piece ? (unsigned int)size : piece;
+	if ( gzwrite( f, p, n ) != (int)n ) {
+	    return false;
+	}
+	p += n;
+	size -= n;
+    }
+    return true;
+}
+
+bool
+GzFile::read( gzFile f, void* data, size_t size ) {
+    char* p = (char*)data;
+    while ( size > 0 ) {
+	const unsigned int n = size < piece ? (unsigned int)size : piece;
+	if ( gzread( f, p, n ) != (int)n ) {
+	    return false;
+	}
+	p += n;
+	size -= n;
+    }
+    return true;
+}
+
+bool
+GzFile::writeHeader( gzFile f, const char* magic, const int version ) {
+    return write( f, magic, strlen(magic) ) && writeInt( f, version );
+}
+
+bool
+GzFile::readHeader( gzFile f, const char* magic, const int version ) {
+    const size_t length = strlen( magic );
+    std::vector<char> header( length + 1, '\0' );
+    int v = 0;
+    return read( f, &header[0], length )
+	&& strncmp( &header[0], magic, length ) == 0
+	&& readInt( f, v ) && v == version;
+}
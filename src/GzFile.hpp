@@ -0,0 +1,65 @@
+// glito/GzFile.hpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#ifndef GZFILE_HPP
+#define GZFILE_HPP
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <cstddef>
+#include <string>
+
+#include <zlib.h>
+
+/** files compressed by zlib (gzip format) which begin with a magic
+    string and a version: the checkpoints and the point clouds.
+    The data are written in the byte order of the machine.
+ */
+namespace GzFile {
+
+    /** open #file#.tmp to write it (level 1: most of the time is spent
+	in the compression). returns NULL if failed
+    */
+    gzFile create( const std::string& file );
+
+    /** close the file opened by create() and rename it #file# if
+	#written#: a file is never left half written. returns 1 if
+	succeed, 0 if failed (#file#.tmp is then removed)
+    */
+    int commit( gzFile f, const std::string& file, bool written );
+
+    /// write #size# bytes. false if failed
+    bool write( gzFile f, const void* data, size_t size );
+
+    /// read #size# bytes. false if the file is shorter
+    bool read( gzFile f, void* data, size_t size );
+
+    inline bool writeInt( gzFile f, int i ) { return write( f, &i, sizeof(int) ); }
+
+    inline bool readInt( gzFile f, int& i ) { return read( f, &i, sizeof(int) ); }
+
+    /// write #magic# and #version#
+    bool writeHeader( gzFile f, const char* magic, int version );
+
+    /// false if the file does not begin with #magic# and #version#
+    bool readHeader( gzFile f, const char* magic, int version );
+}
+
+#endif // GZFILE_HPP
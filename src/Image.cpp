@@ -30,17 +30,22 @@ USA.
 
 #include "Image.hpp"
 #include "IndentedString.hpp"
+#include "Parallel.hpp"
 
 Image::Image() : start(0), wDraw(0), hDraw(0), crop(false), rgbTab(NULL) {
 }
 
-Image::Image( int w, int h, bool color, int wd, int hd, int s )
+Image::Image( int w, int h, bool color, int wd, int hd, int s, bool withRgbTab )
     : ImageGray(w, h, color), start(s), wDraw(wd), hDraw(hd) {
     if ( colored ) {
-        rgbTab = (float*)calloc( 3*sizePixels, sizeof(float) );
-	if ( rgbTab == NULL ) {
-	    std::cerr << "Calloc failed in Image::Image(int,int,bool)!\n";
-	    abort();
+	if ( withRgbTab ) {
+	    rgbTab = (float*)calloc( 3*sizePixels, sizeof(float) );
+	    if ( rgbTab == NULL ) {
+		std::cerr << "Calloc failed in Image::Image(int,int,bool)!\n";
+		abort();
+	    }
+	} else {
+	    rgbTab = NULL;
 	}
 	if ( colorMap.empty() ) {
  	    readDefinedMap(-1);
@@ -92,7 +97,10 @@ Image::copy( const Image& other ) {
 	    std::cerr << "Calloc failed in Image::copy(const Image&)!\n";
 	    abort();
 	}
-	memcpy( rgbTab, other.rgbTab, 3*sizePixels );
+	memcpy( rgbTab, other.rgbTab, 3*sizePixels*sizeof(float) );
+    } else {
+	// the density images store their colors themselves
+	rgbTab = NULL;
     }
 }
 
@@ -113,10 +121,12 @@ Image::mem_clear() {
     }
     if ( colored ) {
         for ( int i = 0; i < 3*sizePixels; ++i ) {
-	    rgbTab[i] = 0;
 	    colorTab[i] = emptyBg;
 	}
     }
+    if ( rgbTab != NULL ) {
+	memset( rgbTab, 0, 3*sizePixels*sizeof(float) );
+    }
 }
 
 void
@@ -136,25 +146,43 @@ Image::mem_plot( int i, int j ) {
 void
 Image::mem_coul( int i, int j, float c ) {
     if ( colored && 0 <= i && i < width && 0 <= j && j < height ) {
-        const int n = i+j*width;
-	float rc = 0;
-	float gc = 0;
-	float bc = 0;
-	int k = 0;
-	while ( k + 1 < colorMap.size()
-		&& !(colorMap[k].c <= c && c <= colorMap[k+1].c) ) {
-	    ++k;
-	}
-	if ( k + 1 < colorMap.size() ) {
-            ElementColorMap& col1 = colorMap[k]; 
-            ElementColorMap& col2 = colorMap[k+1]; 
-	    const float p = (c - col1.c) / (col2.c - col1.c);
-	    rc = (1-p)*col1.r + p*col2.r;
-	    gc = (1-p)*col1.g + p*col2.g;
-	    bc = (1-p)*col1.b + p*col2.b;
+	plotCoordinate( i+j*width, c );
+    }
+}
+
+void
+Image::colorOf( const float c, float* rgb ) {
+    rgb[0] = rgb[1] = rgb[2] = 0;
+    int k = 0;
+    while ( k + 1 < colorMap.size()
+	    && !(colorMap[k].c <= c && c <= colorMap[k+1].c) ) {
+	++k;
+    }
+    if ( k + 1 < colorMap.size() ) {
+	const ElementColorMap& col1 = colorMap[k]; 
+	const ElementColorMap& col2 = colorMap[k+1]; 
+	const float p = (c - col1.c) / (col2.c - col1.c);
+	rgb[0] = (1-p)*col1.r + p*col2.r;
+	rgb[1] = (1-p)*col1.g + p*col2.g;
+	rgb[2] = (1-p)*col1.b + p*col2.b;
+    }
+    assert( k >= 0 && k <= colorMap.size() - 1 );
+}
+
+void
+Image::plotCoordinate( int n, float c ) {
+    float rgb[3];
+    colorOf( c, rgb );
+    plotColor( n, rgb[0], rgb[1], rgb[2] );
+}
+
+void
+Image::prefetch( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	PREFETCH( tab + i+j*width );
+	if ( colored ) {
+	    PREFETCH( colorTab + 3*(i+j*width) );
 	}
-	assert( k >= 0 && k <= colorMap.size() - 1 );
-	plotColor( n, rc, gc, bc );
     }
 }
 
@@ -435,10 +463,13 @@ ImagePseudoDensity::mem_draw() const {
 ///////////////////////////////////////////////////////////////////
 
 ImageDensity::ImageDensity( int w, int h, bool c, int wd, int hd, int s )
-  : Image( w, h, c, wd, hd, s ), maxHit(0) {
+  : Image( w, h, c, wd, hd, s, false ), maxHit(0), coordTab(NULL) {
     hitTab = (int*)calloc( sizePixels, sizeof(int) );
-    if ( hitTab == NULL ) {
-        std::cerr << "calloc of "<< sizePixels*4
+    if ( colored ) {
+	coordTab = (float*)calloc( sizePixels, sizeof(float) );
+    }
+    if ( hitTab == NULL || ( colored && coordTab == NULL ) ) {
+        std::cerr << "calloc of "<< sizePixels*(colored ? 8 : 4)
 		<<" B failed in ImageDensity::ImageDensity(int,int,int,int,int,bool)!\n";
 	abort();
     } else {
@@ -446,15 +477,45 @@ ImageDensity::ImageDensity( int w, int h, bool c, int wd, int hd, int s )
     }
 }
 
+ImageDensity::ImageDensity( int w, int h, bool c, int wd, int hd, int s, bool withHitTab,
+			    bool withCoordTab )
+  : Image( w, h, c, wd, hd, s, false ), maxHit(0), coordTab(NULL), hitTab(NULL) {
+    assert( !withHitTab );
+    if ( colored && withCoordTab ) {
+	coordTab = (float*)calloc( sizePixels, sizeof(float) );
+	if ( coordTab == NULL ) {
+	    std::cerr << "calloc of "<< sizePixels*4
+		      <<" B failed in ImageDensity::ImageDensity(int,int,int,int,int,bool,bool)!\n";
+	    abort();
+	}
+    }
+}
+
 ImageDensity::~ImageDensity() {
     if ( allocated ) {
 	free(hitTab);
     }
+    free(coordTab);
+}
+
+void
+ImageDensity::copyCoordinates( const ImageDensity& other ) {
+    if ( other.coordTab != NULL ) {
+        coordTab = (float*)calloc( sizePixels, sizeof(float) );
+	if ( coordTab == NULL ) {
+	    std::cerr << "Calloc failed in ImageDensity::copyCoordinates(const ImageDensity&)!\n";
+	    abort();
+	}
+	memcpy( coordTab, other.coordTab, sizePixels*sizeof(float) );
+    } else {
+	coordTab = NULL;
+    }
 }
 
 void
 ImageDensity::copy( const ImageDensity& other ) {
     Image::copy( other );
+    copyCoordinates( other );
     if ( other.allocated ) {
 	hitTab = (int*)calloc( sizePixels, sizeof(int) );
 	if ( hitTab == NULL ) {
@@ -481,6 +542,7 @@ ImageDensity::operator=( const ImageDensity& other ) {
 	free(hitTab);
 	allocated = false;
     }
+    free(coordTab);
     copy(other);
     return *this;
 }
@@ -488,15 +550,43 @@ ImageDensity::operator=( const ImageDensity& other ) {
 const int
 ImageDensity::maxMaxHit = std::numeric_limits<int>().max() - 1;
 
+DensityFilter
+ImageDensity::densityFilter = DensityFilter();
+
+std::string
+ImageDensity::countersToXML( HitCounters counters ) {
+    if ( counters == COMPACT_COUNTERS ) {
+	return "compact";
+    } else if ( counters == LOG_COUNTERS ) {
+	return "log";
+    } else if ( counters == SPARSE_COUNTERS ) {
+	return "sparse";
+    } else if ( counters == BRICK_COUNTERS ) {
+	return "brick";
+    } else {
+	return "int";
+    }
+}
+
+HitCounters
+ImageDensity::countersFromXML( const std::string& s ) {
+    if ( s == "compact" ) {
+	return COMPACT_COUNTERS;
+    } else if ( s == "log" ) {
+	return LOG_COUNTERS;
+    } else if ( s == "sparse" ) {
+	return SPARSE_COUNTERS;
+    } else if ( s == "brick" ) {
+	return BRICK_COUNTERS;
+    } else {
+	return INT_COUNTERS;
+    }
+}
+
 void
-ImageDensity::plotColor( int n, float r, float g, float b ) {
-    const float hit = hitTab[n];
-    rgbTab[3*n] = (hit-1)*rgbTab[3*n] + r;
-    rgbTab[3*n] /= hit;
-    rgbTab[3*n+1] = (hit-1)*rgbTab[3*n+1] + g;
-    rgbTab[3*n+1] /= hit;
-    rgbTab[3*n+2] = (hit-1)*rgbTab[3*n+2] + b;
-    rgbTab[3*n+2] /= hit;
+ImageDensity::plotCoordinate( int n, float c ) {
+    const float hit = hitAt(n);
+    coordTab[n] = ( (hit-1)*coordTab[n] + c ) / hit;
 }
 
 void
@@ -513,6 +603,16 @@ ImageDensity::mem_plot( int i, int j ) {
     }
 }
 
+void
+ImageDensity::prefetch( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	PREFETCH( hitTab + i+j*width );
+	if ( colored ) {
+	    PREFETCH( coordTab + i+j*width );
+	}
+    }
+}
+
 int
 ImageDensity::getHit( int i, int j ) const {
     if ( 0 <= i && i < width && 0 <= j && j < height ) {
@@ -528,6 +628,9 @@ ImageDensity::mem_clear() {
     for ( int i = 0; i < sizePixels; ++i ) {
 	hitTab[i] = 0;
     }
+    if ( coordTab != NULL ) {
+	memset( coordTab, 0, sizePixels*sizeof(float) );
+    }
     maxHit = 0;
 }
 
@@ -541,45 +644,1311 @@ ImageDensity::isEmpty() const {
     return true;
 }
 
+void
+ImageDensity::getRow( const int j, int* hits, float* rgb ) const {
+    for ( int i = 0; i < width; ++i ) {
+	hits[i] = hitAt( i + j*width );
+	if ( rgb != NULL ) {
+	    // the colors of the pixels never hit may not be allocated
+	    if ( colored && hits[i] != 0 ) {
+		colorOf( coordinateAt( i + j*width ), rgb + 3*i );
+	    } else {
+		std::fill( rgb + 3*i, rgb + 3*i + 3, 0.0f );
+	    }
+	}
+    }
+}
+
+void
+ImageDensity::getCoordinates( const int j, float* coords ) const {
+    for ( int i = 0; i < width; ++i ) {
+	const int n = i + j*width;
+	coords[i] = colored && hitAt(n) != 0 ? coordinateAt(n) : 0;
+    }
+}
+
+void
+ImageDensity::setRow( const int j, const int* hits, const float* coords ) {
+    for ( int i = 0; i < width; ++i ) {
+	const int n = i + j*width;
+	setPixel( n, std::min( std::max( hits[i], 0 ), maxMaxHit ),
+		  colored ? coords[i] : 0 );
+	maxHit = std::max( maxHit, hitAt(n) );
+    }
+}
+
+void
+ImageDensity::setPixel( const int n, const int hits, const float coord ) {
+    hitTab[n] = hits;
+    if ( colored ) {
+	coordTab[n] = coord;
+    }
+}
+
 void
 ImageDensity::mem_draw() const {
-// const float coef = (float)255 / log1p(maxHit);;
-// tab[i] = (unsigned char)( log1p(hitTab[i]) * coef );
-//  std::cerr<<maxHit<<"\n";
-    std::vector<int> nbHit(256);
-    for ( int c = 0; c <= 255; ++c ) {
-	nbHit[c] = (int)pow( 1 + maxHit, (float)c / 255 ); /* from 1 to 1+maxHit */
+    if ( densityFilter.isActive() ) {
+	drawFiltered();
+	return;
     }
+    const ToneMap toneMap( maxHit );
     if ( background.isBlack() ) {
 	for ( int i = 0; i < sizePixels; ++i ) {
-	    if ( hitTab[i] ) {
-		if ( hitTab[i] > nbHit[tab[i]] ) {
-		    const int gray = std::lower_bound( nbHit.begin(), nbHit.end(), hitTab[i] ) - nbHit.begin();
+	    const int hits = hitAt(i);
+	    if ( hits ) {
+		if ( hits > toneMap.hitsOf(tab[i]) ) {
+		    const int gray = toneMap.level( hits );
 		    tab[i] = (unsigned char)gray;
 		    if ( colored ) {
-			colorTab[3*i  ] = (unsigned char)( rgbTab[3*i  ] * gray );
-			colorTab[3*i+1] = (unsigned char)( rgbTab[3*i+1] * gray );
-			colorTab[3*i+2] = (unsigned char)( rgbTab[3*i+2] * gray );
+			float rgb[3];
+			colorOf( coordinateAt(i), rgb );
+			colorTab[3*i  ] = (unsigned char)( rgb[0] * gray );
+			colorTab[3*i+1] = (unsigned char)( rgb[1] * gray );
+			colorTab[3*i+2] = (unsigned char)( rgb[2] * gray );
 		    }
 		}
 	    }
 	}
     } else {
 	for ( int i = 0; i < sizePixels; ++i ) {
-	    if ( hitTab[i] ) {
-		if ( colored || hitTab[i] > nbHit[255-tab[i]] ) {
-		    const int gray = nbHit.end() - 1 - std::lower_bound( nbHit.begin(), nbHit.end(), hitTab[i] );
+	    const int hits = hitAt(i);
+	    if ( hits ) {
+		if ( colored || hits > toneMap.hitsOf(255-tab[i]) ) {
+		    const int gray = 255 - toneMap.level( hits );
 		    tab[i] = (unsigned char)gray;
 		    if ( colored ) {
-		        colorTab[3*i  ] = (unsigned char)( 255-(1.0-rgbTab[3*i  ])*(255-gray) );
-			colorTab[3*i+1] = (unsigned char)( 255-(1.0-rgbTab[3*i+1])*(255-gray) );
-			colorTab[3*i+2] = (unsigned char)( 255-(1.0-rgbTab[3*i+2])*(255-gray) );
+			float rgb[3];
+			colorOf( coordinateAt(i), rgb );
+		        colorTab[3*i  ] = (unsigned char)( 255-(1.0-rgb[0])*(255-gray) );
+			colorTab[3*i+1] = (unsigned char)( 255-(1.0-rgb[1])*(255-gray) );
+			colorTab[3*i+2] = (unsigned char)( 255-(1.0-rgb[2])*(255-gray) );
+		    }
+		}
+	    }
+	}
+    }
+    Image::mem_draw();
+}
+
+///////////////////////////////////////////////////////////////////
+
+ToneMap::ToneMap( const int maxHit ) : nbHit(256) {
+    for ( int c = 0; c <= 255; ++c ) {
+	nbHit[c] = (int)pow( 1 + maxHit, (float)c / 255 ); /* from 1 to 1+maxHit */
+    }
+}
+
+void
+ToneMap::pixel( const double hits, const float* rgb,
+		unsigned char& gray, unsigned char* color ) const {
+    const Background& background = ImageGray::background;
+    if ( hits <= 0 ) {
+	gray = background.getEmpty();
+	if ( rgb != NULL ) {
+	    color[0] = color[1] = color[2] = background.getEmpty();
+	}
+    } else if ( background.isBlack() ) {
+	gray = (unsigned char)level( hits );
+	if ( rgb != NULL ) {
+	    color[0] = (unsigned char)( rgb[0] * gray );
+	    color[1] = (unsigned char)( rgb[1] * gray );
+	    color[2] = (unsigned char)( rgb[2] * gray );
+	}
+    } else {
+	gray = (unsigned char)( 255 - level( hits ) );
+	if ( rgb != NULL ) {
+	    color[0] = (unsigned char)( 255-(1.0-rgb[0])*(255-gray) );
+	    color[1] = (unsigned char)( 255-(1.0-rgb[1])*(255-gray) );
+	    color[2] = (unsigned char)( 255-(1.0-rgb[2])*(255-gray) );
+	}
+    }
+}
+
+///////////////////////////////////////////////////////////////////
+
+namespace {
+    /// tab and colorTab from the numbers of hits (T: int or filtered float) and the mean colors
+    template <class T>
+    class ToneMapping : public RowTask {
+    public:
+	ToneMapping( const ToneMap& toneMap, int width, const T* sumTab, const float* rgbTab,
+		     unsigned char* tab, unsigned char* colorTab )
+	    : toneMap(toneMap), width(width), sumTab(sumTab), rgbTab(rgbTab),
+	      tab(tab), colorTab(colorTab) {}
+
+	void rows( int begin, int end ) {
+	    for ( int n = begin*width; n < end*width; ++n ) {
+		toneMap.pixel( sumTab[n], colorTab != NULL ? rgbTab + 3*n : NULL,
+			       tab[n], colorTab != NULL ? colorTab + 3*n : NULL );
+	    }
+	}
+
+    private:
+	const ToneMap& toneMap;
+	const int width;
+	const T* sumTab;
+	const float* rgbTab;
+	unsigned char* tab;
+	unsigned char* colorTab;
+    };
+
+    /** levels of the high dynamic range images. see Image::saveHDR.
+	The densities are read in #density# and #rgb#, or if they are
+	empty, asked to the image row by row
+    */
+    class DensityRows : public HdrRows {
+    public:
+	/// #absolute#: linear levels not divided by the maximum
+	DensityRows( const Image& image, const std::vector<float>& density,
+		     const std::vector<float>& rgb, float maxDensity, bool linear, bool absolute )
+	    : image(image), width(image.w()), colored(image.isColored()),
+	      density(density), rgb(rgb), maxDensity(maxDensity), linear(linear),
+	      absolute(absolute), rowDensity( density.empty() ? width : 0 ),
+	      rowRgb( density.empty() && colored ? 3*width : 0 ) {}
+
+	void getRow( int y, float* samples ) {
+	    const float* d;
+	    const float* c;
+	    if ( density.empty() ) {
+		image.getDensityRow( y, &rowDensity[0], colored ? &rowRgb[0] : NULL );
+		d = &rowDensity[0];
+		c = colored ? &rowRgb[0] : NULL;
+	    } else {
+		d = &density[ (size_t)y*width ];
+		c = colored ? &rgb[ (size_t)3*y*width ] : NULL;
+	    }
+	    // the linear levels are not inverted on a white background
+	    const bool black = linear || ImageGray::background.isBlack();
+	    for ( int x = 0; x < width; ++x ) {
+		const float l = level( d[x] );
+		if ( colored ) {
+		    for ( int k = 0; k < 3; ++k ) {
+			samples[3*x+k] = black ? c[3*x+k]*l : 1 - (1-c[3*x+k])*l;
+		    }
+		} else {
+		    samples[x] = black ? l : 1 - l;
+		}
+	    }
+	}
+
+    private:
+	/// same formula as ToneMap without the rounding to 256 levels
+	float level( float d ) const {
+	    if ( d <= 0 || maxDensity <= 0 ) {
+		return 0;
+	    } else if ( !linear ) {
+		return log( 1.0 + d ) / log( 1.0 + maxDensity );
+	    }
+	    return absolute ? d : d / maxDensity;
+	}
+
+	const Image& image;
+	const int width;
+	const bool colored;
+	const std::vector<float>& density;
+	const std::vector<float>& rgb;
+	const float maxDensity;
+	const bool linear;
+	const bool absolute;
+	std::vector<float> rowDensity;
+	std::vector<float> rowRgb;
+    };
+
+    /// level of radius of each pixel. 255: no hit
+    class RadiusLevels : public RowTask {
+    public:
+	RadiusLevels( int width, const int* hits, int maxRadius, float curve,
+		      unsigned char* levels )
+	    : width(width), hits(hits), maxRadius(maxRadius), curve(curve), levels(levels) {}
+
+	void rows( int begin, int end ) {
+	    for ( int n = begin*width; n < end*width; ++n ) {
+		if ( hits[n] == 0 ) {
+		    levels[n] = 255;
+		} else {
+		    const float radius = maxRadius / pow( (float)hits[n], curve );
+		    levels[n] = (unsigned char)std::min( (int)( radius + 0.5 ), maxRadius );
+		}
+	    }
+	}
+
+    private:
+	const int width;
+	const int* hits;
+	const int maxRadius;
+	const float curve;
+	unsigned char* levels;
+    };
+
+    /** horizontal pass of the pixels of a level: the hits and the colors
+	weighted by the hits (#channels# floats per pixel) to #temp#
+    */
+    class HorizontalBlur : public RowTask {
+    public:
+	HorizontalBlur( int width, int channels, const int* hits, const float* rgb,
+			const unsigned char* levels, int level,
+			const std::vector<float>& kernel, float* temp )
+	    : width(width), channels(channels), hits(hits), rgb(rgb), levels(levels),
+	      level(level), kernel(kernel), temp(temp) {}
+
+	void rows( int begin, int end ) {
+	    const int radius = (int)kernel.size() / 2;
+	    for ( int y = begin; y < end; ++y ) {
+		float* out = temp + channels*y*width;
+		std::fill( out, out + channels*width, 0.0f );
+		for ( int x = 0; x < width; ++x ) {
+		    const int n = x + y*width;
+		    if ( levels[n] != level ) {
+			continue;
+		    }
+		    // scattered: the sparse pixels are few
+		    const int first = std::max( x - radius, 0 );
+		    const int last = std::min( x + radius, width - 1 );
+		    for ( int l = first; l <= last; ++l ) {
+			const float weight = kernel[l - x + radius] * hits[n];
+			out[channels*l] += weight;
+			for ( int c = 1; c < channels; ++c ) {
+			    out[channels*l + c] += weight * rgb[3*n + c-1];
+			}
+		    }
+		}
+	    }
+	}
+
+    private:
+	const int width;
+	const int channels;
+	const int* hits;
+	const float* rgb;
+	const unsigned char* levels;
+	const int level;
+	const std::vector<float>& kernel;
+	float* temp;
+    };
+
+    /// vertical pass of #temp#, added to #sum#
+    class VerticalBlur : public RowTask {
+    public:
+	VerticalBlur( int width, int height, int channels,
+		      const std::vector<float>& kernel, const float* temp, float* sum )
+	    : width(width), height(height), channels(channels),
+	      kernel(kernel), temp(temp), sum(sum) {}
+
+	void rows( int begin, int end ) {
+	    const int radius = (int)kernel.size() / 2;
+	    const int rowSize = channels*width;
+	    for ( int y = begin; y < end; ++y ) {
+		float* out = sum + y*rowSize;
+		const int first = std::max( y - radius, 0 );
+		const int last = std::min( y + radius, height - 1 );
+		for ( int k = first; k <= last; ++k ) {
+		    const float weight = kernel[k - y + radius];
+		    const float* in = temp + k*rowSize;
+		    for ( int e = 0; e < rowSize; ++e ) {
+			out[e] += weight * in[e];
+		    }
+		}
+	    }
+	}
+
+    private:
+	const int width;
+	const int height;
+	const int channels;
+	const std::vector<float>& kernel;
+	const float* temp;
+	float* sum;
+    };
+
+    /// density and mean colors from the sums
+    class FilteredPixels : public RowTask {
+    public:
+	FilteredPixels( int width, int height, int channels, const float* sum,
+			float* rgb, float* density )
+	    : width(width), channels(channels), sum(sum), rgb(rgb), density(density),
+	      rowMax( height, 0.0f ) {}
+
+	void rows( int begin, int end ) {
+	    for ( int y = begin; y < end; ++y ) {
+		for ( int n = y*width; n < (y+1)*width; ++n ) {
+		    const float* s = sum + channels*n;
+		    density[n] = s[0];
+		    rowMax[y] = std::max( rowMax[y], s[0] );
+		    if ( channels > 1 && s[0] > 0 ) {
+			rgb[3*n  ] = std::min( s[1] / s[0], 1.0f );
+			rgb[3*n+1] = std::min( s[2] / s[0], 1.0f );
+			rgb[3*n+2] = std::min( s[3] / s[0], 1.0f );
 		    }
 		}
 	    }
 	}
+
+	float maxDensity() const { return *std::max_element( rowMax.begin(), rowMax.end() ); }
+
+    private:
+	const int width;
+	const int channels;
+	const float* sum;
+	float* rgb;
+	float* density;
+	/// written by the thread of each row
+	std::vector<float> rowMax;
+    };
+}
+
+DensityFilter::DensityFilter() : maxRadius(0), curve(0.4) {
+}
+
+void
+DensityFilter::setMaxRadius( const int r ) {
+    maxRadius = std::min( std::max( r, 0 ), (int)maxMaxRadius );
+}
+
+void
+DensityFilter::setCurve( const float c ) {
+    if ( c > 0 ) {
+	curve = c;
+    }
+}
+
+float
+DensityFilter::apply( const int w, const int h, const int* hits, float* rgb,
+		      float* density ) const {
+    const int channels = rgb != NULL ? 4 : 1;
+    std::vector<unsigned char> levels( w*h );
+    RadiusLevels radiusLevels( w, hits, maxRadius, curve, &levels[0] );
+    Parallel::rows( radiusLevels, h );
+    std::vector<bool> used( maxRadius + 1, false );
+    for ( int n = 0; n < w*h; ++n ) {
+	if ( levels[n] != 255 ) {
+	    used[ levels[n] ] = true;
+	}
+    }
+    std::vector<float> sum( channels*w*h, 0.0f );
+    std::vector<float> temp( channels*w*h );
+    for ( int level = 0; level <= maxRadius; ++level ) {
+	if ( !used[level] ) {
+	    continue;
+	}
+	// normalized gaussian of standard deviation radius/2
+	std::vector<float> kernel( 2*level + 1 );
+	float total = 0;
+	for ( int d = -level; d <= level; ++d ) {
+	    kernel[d + level] = level == 0 ? 1 : exp( -2.0 * d*d / ( level*level ) );
+	    total += kernel[d + level];
+	}
+	for ( int d = 0; d <= 2*level; ++d ) {
+	    kernel[d] /= total;
+	}
+	HorizontalBlur horizontal( w, channels, hits, rgb, &levels[0], level, kernel, &temp[0] );
+	Parallel::rows( horizontal, h );
+	VerticalBlur vertical( w, h, channels, kernel, &temp[0], &sum[0] );
+	Parallel::rows( vertical, h );
+    }
+    FilteredPixels pixels( w, h, channels, &sum[0], rgb, density );
+    Parallel::rows( pixels, h );
+    return pixels.maxDensity();
+}
+
+float
+ImageDensity::getDensity( std::vector<float>& density, std::vector<float>& rgb ) const {
+    std::vector<int> hits( sizePixels );
+    rgb.assign( colored ? 3*sizePixels : 0, 0.0f );
+    for ( int j = 0; j < height; ++j ) {
+	getRow( j, &hits[j*width], colored ? &rgb[3*j*width] : NULL );
+    }
+    density.resize( sizePixels );
+    if ( densityFilter.isActive() ) {
+	return densityFilter.apply( width, height, &hits[0], colored ? &rgb[0] : NULL, &density[0] );
+    }
+    std::copy( hits.begin(), hits.end(), density.begin() );
+    return maxHit;
+}
+
+float
+ImageDensity::startDensityRows() const {
+    return densityFilter.isActive() ? -1 : maxHit;
+}
+
+void
+ImageDensity::getDensityRow( const int y, float* density, float* rgb ) const {
+    for ( int i = 0; i < width; ++i ) {
+	const int n = i + y*width;
+	const int hits = hitAt(n);
+	density[i] = hits;
+	if ( rgb != NULL ) {
+	    if ( hits != 0 ) {
+		colorOf( coordinateAt(n), rgb + 3*i );
+	    } else {
+		std::fill( rgb + 3*i, rgb + 3*i + 3, 0.0f );
+	    }
+	}
+    }
+}
+
+void
+ImageDensity::drawFiltered() const {
+    std::vector<float> density;
+    std::vector<float> rgb;
+    const float maxDensity = getDensity( density, rgb );
+    drawDensity( density, colored ? &rgb[0] : NULL, maxDensity );
+}
+
+bool
+ImageDensity::remap() const {
+    if ( densityFilter.isActive() ) {
+	drawFiltered();
+	return true;
+    }
+    const ToneMap toneMap( maxHit );
+    std::vector<int> hits( width );
+    std::vector<float> rgb( colored ? 3*width : 0 );
+    for ( int j = 0; j < height; ++j ) {
+	getRow( j, &hits[0], colored ? &rgb[0] : NULL );
+	for ( int i = 0; i < width; ++i ) {
+	    const int n = i + j*width;
+	    toneMap.pixel( hits[i], colored ? &rgb[3*i] : NULL,
+			   tab[n], colored ? colorTab + 3*n : NULL );
+	}
     }
     Image::mem_draw();
+    return true;
+}
+
+void
+Image::drawDensity( const std::vector<float>& density, const float* rgb,
+		    const float maxDensity ) const {
+    const ToneMap toneMap( (int)std::min( ceil( maxDensity ), (float)ImageDensity::maxMaxHit ) );
+    ToneMapping<float> toneMapping( toneMap, width, &density[0], rgb, tab,
+				    colored ? colorTab : NULL );
+    Parallel::rows( toneMapping, height );
+    Image::mem_draw();
+}
+
+int
+Image::saveHDR( FILE* fp, const imageFormat format, const bool linear,
+		const std::string& description ) const {
+    std::vector<float> density;
+    std::vector<float> rgb;
+    // without density filter the rows are computed one after the other from the counters
+    float maxDensity = startDensityRows();
+    if ( maxDensity < 0 ) {
+	maxDensity = getDensity( density, rgb );
+    }
+    if ( maxDensity >= 0 ) {
+	DensityRows rows( *this, density, rgb, maxDensity, linear, format == PFM );
+	if ( format == PFM ) {
+	    return writePFM( fp, width, height, colored, rows );
+	}
+#ifdef HAVE_LIBPNG
+	if ( format == PNG16 ) {
+	    return writePNG16( fp, width, height, colored, rows, description );
+	}
+#endif
+    }
+    fclose(fp);
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////
+
+PlotPipeline::PlotPipeline( Image& image, const int distance )
+    : image(image), distance( std::min( std::max( distance, 0 ), (int)maxDistance ) ), next(0) {
+    for ( int k = 0; k < maxDistance; ++k ) {
+	points[k].i = -1;
+	points[k].j = -1;
+	points[k].c = 0;
+    }
+}
+
+void
+PlotPipeline::flush() {
+    // oldest first
+    for ( int k = 0; k < distance; ++k ) {
+	Point& p = points[ (next + k) % distance ];
+	image.mem_plot( p.i, p.j );
+	image.mem_coul( p.i, p.j, p.c );
+	p.i = -1;
+	p.j = -1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////
+
+void
+PlotBins::bind( Image& im ) {
+    image = &im;
+    width = im.plotW();
+    height = im.plotH();
+    const int nbBins = ( ( width*height - 1 ) >> binShift ) + 1;
+    // the memory of the points is kept from one image to the next
+    points.resize( nbBins*binCapacity );
+    sizes.assign( nbBins, 0 );
+}
+
+void
+PlotBins::flushBin( const int b ) {
+    const Point* p = &points[ b*binCapacity ];
+    for ( const Point* end = p + sizes[b]; p != end; ++p ) {
+	image->mem_plot( p->i, p->j );
+	image->mem_coul( p->i, p->j, p->c );
+    }
+    sizes[b] = 0;
+}
+
+void
+PlotBins::flush() {
+    for ( int b = 0; b < (int)sizes.size(); ++b ) {
+	if ( sizes[b] != 0 ) {
+	    flushBin(b);
+	}
+    }
+}
+
+///////////////////////////////////////////////////////////////////
+
+HitOverflow::HitOverflow() : keys(16, -1), values(16, 0), count(0), shift(28) {
+}
+
+int
+HitOverflow::slot( int n ) const {
+    const int mask = keys.size() - 1;
+    // Fibonacci hashing: neighbour pixels are spread over the table
+    int k = (int)( ( (unsigned int)n * 2654435761u ) >> shift );
+    while ( keys[k] != -1 && keys[k] != n ) {
+	k = (k + 1) & mask;
+    }
+    return k;
+}
+
+int
+HitOverflow::get( int n ) const {
+    const int k = slot(n);
+    return keys[k] == n ? values[k] : 0;
+}
+
+void
+HitOverflow::set( int n, int hits ) {
+    int k = slot(n);
+    if ( keys[k] == -1 ) {
+	if ( 2*(count+1) > (int)keys.size() ) {
+	    grow();
+	    k = slot(n);
+	}
+	keys[k] = n;
+	++count;
+    }
+    values[k] = hits;
+}
+
+void
+HitOverflow::grow() {
+    std::vector<int> oldKeys( 2*keys.size(), -1 );
+    std::vector<int> oldValues( 2*values.size(), 0 );
+    // keys and values become the empty larger table:
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    --shift;
+    for ( int k = 0; k < (int)oldKeys.size(); ++k ) {
+	if ( oldKeys[k] != -1 ) {
+	    const int newK = slot(oldKeys[k]);
+	    keys[newK] = oldKeys[k];
+	    values[newK] = oldValues[k];
+	}
+    }
+}
+
+void
+HitOverflow::clear() {
+    keys.assign( 16, -1 );
+    values.assign( 16, 0 );
+    count = 0;
+    shift = 28;
+}
+
+ImageCompactDensity::ImageCompactDensity( int w, int h, bool c, int wd, int hd, int s )
+    : ImageDensity( w, h, c, wd, hd, s, false ) {
+    compactTab = (unsigned short*)calloc( sizePixels, sizeof(unsigned short) );
+    if ( compactTab == NULL ) {
+        std::cerr << "calloc of "<< sizePixels*2
+		<<" B failed in ImageCompactDensity::ImageCompactDensity(int,int,bool,int,int,int)!\n";
+	abort();
+    }
+}
+
+ImageCompactDensity::~ImageCompactDensity() {
+    free(compactTab);
+}
+
+void
+ImageCompactDensity::copy( const ImageCompactDensity& other ) {
+    Image::copy( other );
+    copyCoordinates( other );
+    compactTab = (unsigned short*)calloc( sizePixels, sizeof(unsigned short) );
+    if ( compactTab == NULL ) {
+	std::cerr << "Calloc failed in ImageCompactDensity::copy(const ImageCompactDensity&)!\n";
+	abort();
+    }
+    memcpy( compactTab, other.compactTab, sizePixels*sizeof(unsigned short) );
+    overflow = other.overflow;
+    maxHit = other.maxHit;
+}
+
+ImageCompactDensity&
+ImageCompactDensity::operator=( const ImageCompactDensity& other ) {
+    if ( allocated ) {
+	free(tab);
+	if ( colored ) {
+	  free(colorTab);
+	}
+	allocated = false;
+    }
+    free(compactTab);
+    free(coordTab);
+    copy(other);
+    return *this;
+}
+
+void
+ImageCompactDensity::mem_plot( int i, int j ) {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	const int n = i+j*width;
+	unsigned short* element = &compactTab[n];
+	int hits;
+	if ( *element < saturated - 1 ) {
+	    hits = ++(*element);
+	} else {
+	    // the counter moves to the overflow table
+	    hits = ( *element == saturated ) ? overflow.get(n) + 1 : saturated;
+	    if ( hits > maxMaxHit ) { // to avoid int > MAX_INT
+		return;
+	    }
+	    *element = saturated;
+	    overflow.set( n, hits );
+	}
+  	if ( hits > maxHit ) {
+	    maxHit = hits;
+  	}
+    }
+}
+
+void
+ImageCompactDensity::prefetch( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	PREFETCH( compactTab + i+j*width );
+	if ( colored ) {
+	    PREFETCH( coordTab + i+j*width );
+	}
+    }
+}
+
+int
+ImageCompactDensity::getHit( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	return hitAt( i+j*width );
+    } else {
+	return 0;
+    }
+}
+
+void
+ImageCompactDensity::mem_clear() {
+    Image::mem_clear();
+    memset( compactTab, 0, sizePixels*sizeof(unsigned short) );
+    if ( colored ) {
+	memset( coordTab, 0, sizePixels*sizeof(float) );
+    }
+    overflow.clear();
+    maxHit = 0;
+}
+
+void
+ImageCompactDensity::setPixel( const int n, const int hits, const float coord ) {
+    if ( hits >= saturated ) {
+	compactTab[n] = saturated;
+	overflow.set( n, hits );
+    } else {
+	compactTab[n] = (unsigned short)hits;
+    }
+    if ( colored ) {
+	coordTab[n] = coord;
+    }
+}
+
+bool
+ImageCompactDensity::isEmpty() const {
+    for ( int i = 0; i < sizePixels; ++i ) {
+	if ( compactTab[i] != 0 ) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////
+
+ImageSparseDensity::ImageSparseDensity( int w, int h, bool c, int wd, int hd, int s )
+    : ImageDensity( w, h, c, wd, hd, s, false, false ),
+      tilesX( (w + tileSize - 1) >> tileShift ) {
+    const int tiles = tilesX * ( (h + tileSize - 1) >> tileShift );
+    hitTiles.assign( tiles, (int*)NULL );
+    if ( colored ) {
+	coordTiles.assign( tiles, (float*)NULL );
+    }
+}
+
+ImageSparseDensity::~ImageSparseDensity() {
+    freeTiles();
+}
+
+void
+ImageSparseDensity::copy( const ImageSparseDensity& other ) {
+    Image::copy( other );
+    tilesX = other.tilesX;
+    hitTiles.assign( other.hitTiles.size(), (int*)NULL );
+    coordTiles.assign( other.coordTiles.size(), (float*)NULL );
+    for ( int t = 0; t < (int)hitTiles.size(); ++t ) {
+	if ( other.hitTiles[t] != NULL ) {
+	    allocateTile(t);
+	    memcpy( hitTiles[t], other.hitTiles[t], tileSize*tileSize*sizeof(int) );
+	    if ( colored ) {
+		memcpy( coordTiles[t], other.coordTiles[t], tileSize*tileSize*sizeof(float) );
+	    }
+	}
+    }
+    maxHit = other.maxHit;
+}
+
+ImageSparseDensity&
+ImageSparseDensity::operator=( const ImageSparseDensity& other ) {
+    if ( allocated ) {
+	free(tab);
+	if ( colored ) {
+	  free(colorTab);
+	}
+	allocated = false;
+    }
+    freeTiles();
+    copy(other);
+    return *this;
+}
+
+void
+ImageSparseDensity::allocateTile( int t ) {
+    hitTiles[t] = (int*)calloc( tileSize*tileSize, sizeof(int) );
+    if ( colored ) {
+	coordTiles[t] = (float*)calloc( tileSize*tileSize, sizeof(float) );
+    }
+    if ( hitTiles[t] == NULL || ( colored && coordTiles[t] == NULL ) ) {
+	std::cerr << "Calloc failed in ImageSparseDensity::allocateTile(int)!\n";
+	abort();
+    }
+}
+
+void
+ImageSparseDensity::freeTiles() {
+    for ( int t = 0; t < (int)hitTiles.size(); ++t ) {
+	free( hitTiles[t] );
+	hitTiles[t] = NULL;
+    }
+    for ( int t = 0; t < (int)coordTiles.size(); ++t ) {
+	free( coordTiles[t] );
+	coordTiles[t] = NULL;
+    }
+}
+
+int
+ImageSparseDensity::tilesUsed() const {
+    int used = 0;
+    for ( int t = 0; t < (int)hitTiles.size(); ++t ) {
+	if ( hitTiles[t] != NULL ) {
+	    ++used;
+	}
+    }
+    return used;
+}
+
+void
+ImageSparseDensity::mem_plot( int i, int j ) {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	const int t = tileOf( i, j );
+	if ( hitTiles[t] == NULL ) {
+	    allocateTile(t);
+	}
+	int* element = &hitTiles[t][ inTile( i, j ) ];
+ 	const int hits = ++(*element);
+  	if ( hits > maxHit ) {
+	    maxHit = hits;
+	    if ( maxHit > maxMaxHit ) { // to avoid int > MAX_INT
+	        --(*element);
+		--maxHit;
+	    }
+  	}
+    }
+}
+
+void
+ImageSparseDensity::prefetch( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	const int t = tileOf( i, j );
+	if ( hitTiles[t] != NULL ) {
+	    PREFETCH( hitTiles[t] + inTile( i, j ) );
+	    if ( colored ) {
+		PREFETCH( coordTiles[t] + inTile( i, j ) );
+	    }
+	}
+    }
+}
+
+void
+ImageSparseDensity::plotCoordinate( int n, float c ) {
+    const int i = n%width;
+    const int j = n/width;
+    const float hit = hitTiles[ tileOf( i, j ) ][ inTile( i, j ) ];
+    float* coord = coordTiles[ tileOf( i, j ) ] + inTile( i, j );
+    *coord = ( (hit-1)*(*coord) + c ) / hit;
+}
+
+void
+ImageSparseDensity::setPixel( const int n, const int hits, const float coord ) {
+    const int t = tileOf( n%width, n/width );
+    if ( hitTiles[t] == NULL ) {
+	if ( hits == 0 ) {
+	    return;
+	}
+	allocateTile(t);
+    }
+    hitTiles[t][ inTile( n%width, n/width ) ] = hits;
+    if ( colored ) {
+	coordTiles[t][ inTile( n%width, n/width ) ] = coord;
+    }
+}
+
+int
+ImageSparseDensity::getHit( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	const int* tile = hitTiles[ tileOf( i, j ) ];
+	return tile == NULL ? 0 : tile[ inTile( i, j ) ];
+    } else {
+	return 0;
+    }
+}
+
+void
+ImageSparseDensity::mem_clear() {
+    Image::mem_clear();
+    // only the tiles which were hit have to be cleared
+    freeTiles();
+    maxHit = 0;
+}
+
+bool
+ImageSparseDensity::isEmpty() const {
+    return tilesUsed() == 0;
+}
+
+///////////////////////////////////////////////////////////////////
+
+ImageBrickDensity::ImageBrickDensity( int w, int h, bool c, int wd, int hd, int s )
+    : ImageDensity( w, h, c, wd, hd, s, false, false ),
+      bricksX( (w + brickSize - 1) >> brickShift ),
+      sizeBricks( bricksX * ( (h + brickSize - 1) >> brickShift ) << (2*brickShift) ),
+      brickCoord(NULL) {
+    brickTab = (int*)calloc( sizeBricks, sizeof(int) );
+    if ( colored ) {
+	brickCoord = (float*)calloc( sizeBricks, sizeof(float) );
+    }
+    if ( brickTab == NULL || ( colored && brickCoord == NULL ) ) {
+        std::cerr << "calloc of "<< sizeBricks*(colored ? 8 : 4)
+		<<" B failed in ImageBrickDensity::ImageBrickDensity(int,int,bool,int,int,int)!\n";
+	abort();
+    }
+}
+
+ImageBrickDensity::~ImageBrickDensity() {
+    free(brickTab);
+    free(brickCoord);
+}
+
+void
+ImageBrickDensity::copy( const ImageBrickDensity& other ) {
+    Image::copy( other );
+    bricksX = other.bricksX;
+    sizeBricks = other.sizeBricks;
+    brickTab = (int*)calloc( sizeBricks, sizeof(int) );
+    brickCoord = colored ? (float*)calloc( sizeBricks, sizeof(float) ) : NULL;
+    if ( brickTab == NULL || ( colored && brickCoord == NULL ) ) {
+	std::cerr << "Calloc failed in ImageBrickDensity::copy(const ImageBrickDensity&)!\n";
+	abort();
+    }
+    memcpy( brickTab, other.brickTab, sizeBricks*sizeof(int) );
+    if ( colored ) {
+	memcpy( brickCoord, other.brickCoord, sizeBricks*sizeof(float) );
+    }
+    maxHit = other.maxHit;
+}
+
+ImageBrickDensity&
+ImageBrickDensity::operator=( const ImageBrickDensity& other ) {
+    if ( allocated ) {
+	free(tab);
+	if ( colored ) {
+	  free(colorTab);
+	}
+	allocated = false;
+    }
+    free(brickTab);
+    free(brickCoord);
+    copy(other);
+    return *this;
+}
+
+void
+ImageBrickDensity::mem_plot( int i, int j ) {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	int* element = &brickTab[ brickIndex( i, j ) ];
+ 	const int hits = ++(*element);
+  	if ( hits > maxHit ) {
+	    maxHit = hits;
+	    if ( maxHit > maxMaxHit ) { // to avoid int > MAX_INT
+	        --(*element);
+		--maxHit;
+	    }
+  	}
+    }
+}
+
+void
+ImageBrickDensity::prefetch( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	PREFETCH( brickTab + brickIndex( i, j ) );
+	if ( colored ) {
+	    PREFETCH( brickCoord + brickIndex( i, j ) );
+	}
+    }
+}
+
+void
+ImageBrickDensity::plotCoordinate( int n, float c ) {
+    const int k = brickIndex( n%width, n/width );
+    const float hit = brickTab[k];
+    brickCoord[k] = ( (hit-1)*brickCoord[k] + c ) / hit;
+}
+
+void
+ImageBrickDensity::setPixel( const int n, const int hits, const float coord ) {
+    const int k = brickIndex( n%width, n/width );
+    brickTab[k] = hits;
+    if ( colored ) {
+	brickCoord[k] = coord;
+    }
+}
+
+int
+ImageBrickDensity::getHit( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	return brickTab[ brickIndex( i, j ) ];
+    } else {
+	return 0;
+    }
+}
+
+void
+ImageBrickDensity::mem_clear() {
+    Image::mem_clear();
+    memset( brickTab, 0, sizeBricks*sizeof(int) );
+    if ( colored ) {
+	memset( brickCoord, 0, sizeBricks*sizeof(float) );
+    }
+    maxHit = 0;
+}
+
+bool
+ImageBrickDensity::isEmpty() const {
+    for ( int k = 0; k < sizeBricks; ++k ) {
+	if ( brickTab[k] != 0 ) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////
+
+namespace {
+    /// sum of the hits and mean color of the squares of factor x factor pixels
+    class BoxFilter : public RowTask {
+    public:
+	BoxFilter( const ImageDensity& fine, int factor, int width, bool colored,
+		   int* sumTab, float* rgbTab )
+	    : fine(fine), factor(factor), width(width), colored(colored),
+	      sumTab(sumTab), rgbTab(rgbTab), rowMax( fine.h() / factor, 0 ) {}
+
+	void rows( int begin, int end ) {
+	    std::vector<int> hits( fine.w() );
+	    std::vector<float> rgb( colored ? 3*fine.w() : 0 );
+	    std::vector<float> rgbSum( colored ? 3*width : 0 );
+	    // factor^2 counters of up to maxMaxHit overflow an int: clamped when stored in sumTab
+	    std::vector<long long> sums( width );
+	    for ( int y = begin; y < end; ++y ) {
+		std::fill( sums.begin(), sums.end(), 0 );
+		std::fill( rgbSum.begin(), rgbSum.end(), 0.0f );
+		for ( int k = 0; k < factor; ++k ) {
+		    fine.getRow( y*factor + k, &hits[0], colored ? &rgb[0] : NULL );
+		    for ( int x = 0; x < width; ++x ) {
+			for ( int l = x*factor; l < (x+1)*factor; ++l ) {
+			    sums[x] += hits[l];
+			    if ( colored ) {
+				// the mean color is weighted by the hits
+				rgbSum[3*x  ] += hits[l] * rgb[3*l  ];
+				rgbSum[3*x+1] += hits[l] * rgb[3*l+1];
+				rgbSum[3*x+2] += hits[l] * rgb[3*l+2];
+			    }
+			}
+		    }
+		}
+		for ( int x = 0; x < width; ++x ) {
+		    const int sum = (int)std::min( sums[x], (long long)ImageDensity::maxMaxHit );
+		    sumTab[x + y*width] = sum;
+		    rowMax[y] = std::max( rowMax[y], sum );
+		    if ( colored && sums[x] != 0 ) {
+			rgbTab[3*(x + y*width)  ] = rgbSum[3*x  ] / sums[x];
+			rgbTab[3*(x + y*width)+1] = rgbSum[3*x+1] / sums[x];
+			rgbTab[3*(x + y*width)+2] = rgbSum[3*x+2] / sums[x];
+		    }
+		}
+	    }
+	}
+
+	int maxHit() const { return *std::max_element( rowMax.begin(), rowMax.end() ); }
+
+    private:
+	const ImageDensity& fine;
+	const int factor;
+	const int width;
+	const bool colored;
+	int* sumTab;
+	float* rgbTab;
+	/// written by the thread of each row
+	std::vector<int> rowMax;
+    };
+}
+
+ImageSupersampled::ImageSupersampled( ImageDensity* f, int fac, int wd, int hd, int s )
+    : Image( f->w()/fac, f->h()/fac, f->isColored(), wd, hd, s ), fine(f), factor(fac) {
+    sumTab = (int*)calloc( sizePixels, sizeof(int) );
+    if ( sumTab == NULL ) {
+        std::cerr << "calloc of "<< sizePixels*4
+		<<" B failed in ImageSupersampled::ImageSupersampled(ImageDensity*,int,int,int,int)!\n";
+	abort();
+    }
+}
+
+ImageSupersampled::~ImageSupersampled() {
+    delete fine;
+    free(sumTab);
+}
+
+void
+ImageSupersampled::mem_clear() {
+    Image::mem_clear();
+    fine->mem_clear();
+}
+
+void
+ImageSupersampled::mem_draw() const {
+    BoxFilter boxFilter( *fine, factor, width, colored, sumTab, rgbTab );
+    Parallel::rows( boxFilter, height );
+    if ( ImageDensity::densityFilter.isActive() ) {
+	std::vector<float> density( sizePixels );
+	const float maxDensity = ImageDensity::densityFilter.apply(
+	    width, height, sumTab, colored ? rgbTab : NULL, &density[0] );
+	drawDensity( density, colored ? rgbTab : NULL, maxDensity );
+	return;
+    }
+    const ToneMap toneMap( boxFilter.maxHit() );
+    ToneMapping<int> toneMapping( toneMap, width, sumTab, rgbTab, tab, colored ? colorTab : NULL );
+    Parallel::rows( toneMapping, height );
+    Image::mem_draw();
+}
+
+float
+ImageSupersampled::getDensity( std::vector<float>& density, std::vector<float>& rgb ) const {
+    BoxFilter boxFilter( *fine, factor, width, colored, sumTab, rgbTab );
+    Parallel::rows( boxFilter, height );
+    density.resize( sizePixels );
+    if ( colored ) {
+	rgb.assign( rgbTab, rgbTab + 3*sizePixels );
+    } else {
+	rgb.clear();
+    }
+    if ( ImageDensity::densityFilter.isActive() ) {
+	return ImageDensity::densityFilter.apply( width, height, sumTab,
+						  colored ? &rgb[0] : NULL, &density[0] );
+    }
+    std::copy( sumTab, sumTab + sizePixels, density.begin() );
+    return boxFilter.maxHit();
+}
+
+float
+ImageSupersampled::startDensityRows() const {
+    if ( ImageDensity::densityFilter.isActive() ) {
+	return -1;
+    }
+    BoxFilter boxFilter( *fine, factor, width, colored, sumTab, rgbTab );
+    Parallel::rows( boxFilter, height );
+    return boxFilter.maxHit();
+}
+
+void
+ImageSupersampled::getDensityRow( const int y, float* density, float* rgb ) const {
+    const int* sums = sumTab + y*width;
+    std::copy( sums, sums + width, density );
+    if ( rgb != NULL ) {
+	for ( int x = 0; x < width; ++x ) {
+	    if ( sums[x] != 0 ) {
+		std::copy( rgbTab + 3*(x + y*width), rgbTab + 3*(x + y*width) + 3, rgb + 3*x );
+	    } else {
+		// not written by BoxFilter
+		std::fill( rgb + 3*x, rgb + 3*x + 3, 0.0f );
+	    }
+	}
+    }
+}
+
+///////////////////////////////////////////////////////////////////
+
+MorrisCounter::MorrisCounter() {
+    setBase( 1.08 );
+}
+
+void
+MorrisCounter::setBase( float b ) {
+    base = b;
+    for ( int c = 0; c < 256; ++c ) {
+	const double e = ( pow( (double)base, c ) - 1 ) / ( base - 1 );
+	estimates[c] = e < ImageDensity::maxMaxHit ? (int)( e + 0.5 ) : ImageDensity::maxMaxHit;
+	// probability base^-c to go from estimate(c) to estimate(c+1):
+	const double p = pow( (double)base, -c ) * 4294967296.0;
+	thresholds[c] = p < 4294967295.0 ? (unsigned int)p : 4294967295u;
+    }
+}
+
+unsigned char
+MorrisCounter::counter( const int hits ) const {
+    const int c = std::lower_bound( estimates, estimates + 256, hits ) - estimates;
+    if ( c == 256 ) {
+	return 255;
+    } else if ( c > 0 && hits - estimates[c-1] < estimates[c] - hits ) {
+	return (unsigned char)( c - 1 );
+    }
+    return (unsigned char)c;
+}
+
+MorrisCounter
+ImageLogDensity::morrisCounter = MorrisCounter();
+
+ImageLogDensity::ImageLogDensity( int w, int h, bool c, int wd, int hd, int s )
+    : ImageDensity( w, h, c, wd, hd, s, false ), randomState( 1 + rand() ) {
+    logTab = (unsigned char*)calloc( sizePixels, sizeof(unsigned char) );
+    if ( logTab == NULL ) {
+        std::cerr << "calloc of "<< sizePixels
+		<<" B failed in ImageLogDensity::ImageLogDensity(int,int,bool,int,int,int)!\n";
+	abort();
+    }
+}
+
+ImageLogDensity::~ImageLogDensity() {
+    free(logTab);
+}
+
+void
+ImageLogDensity::copy( const ImageLogDensity& other ) {
+    Image::copy( other );
+    copyCoordinates( other );
+    logTab = (unsigned char*)calloc( sizePixels, sizeof(unsigned char) );
+    if ( logTab == NULL ) {
+	std::cerr << "Calloc failed in ImageLogDensity::copy(const ImageLogDensity&)!\n";
+	abort();
+    }
+    memcpy( logTab, other.logTab, sizePixels );
+    randomState = other.randomState;
+    maxHit = other.maxHit;
+}
+
+ImageLogDensity&
+ImageLogDensity::operator=( const ImageLogDensity& other ) {
+    if ( allocated ) {
+	free(tab);
+	if ( colored ) {
+	  free(colorTab);
+	}
+	allocated = false;
+    }
+    free(logTab);
+    free(coordTab);
+    copy(other);
+    return *this;
+}
+
+void
+ImageLogDensity::mem_plot( int i, int j ) {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	unsigned char* element = &logTab[i+j*width];
+	if ( morrisCounter.increment( *element, nextRandom() ) ) {
+	    const int hits = morrisCounter.estimate( ++(*element) );
+	    if ( hits > maxHit ) {
+		maxHit = hits;
+	    }
+	}
+    }
+}
+
+void
+ImageLogDensity::prefetch( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	PREFETCH( logTab + i+j*width );
+	if ( colored ) {
+	    PREFETCH( coordTab + i+j*width );
+	}
+    }
+}
+
+void
+ImageLogDensity::setPixel( const int n, const int hits, const float coord ) {
+    logTab[n] = morrisCounter.counter( hits );
+    if ( colored ) {
+	coordTab[n] = coord;
+    }
+}
+
+int
+ImageLogDensity::getHit( int i, int j ) const {
+    if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	return hitAt( i+j*width );
+    } else {
+	return 0;
+    }
+}
+
+void
+ImageLogDensity::mem_clear() {
+    Image::mem_clear();
+    memset( logTab, 0, sizePixels );
+    if ( colored ) {
+	memset( coordTab, 0, sizePixels*sizeof(float) );
+    }
+    maxHit = 0;
+}
+
+bool
+ImageLogDensity::isEmpty() const {
+    for ( int i = 0; i < sizePixels; ++i ) {
+	if ( logTab[i] != 0 ) {
+	    return false;
+	}
+    }
+    return true;
 }
 
 /*
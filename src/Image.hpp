@@ -19,8 +19,19 @@ USA.
 #ifndef IMAGE_HPP
 #define IMAGE_HPP
 
+#include <algorithm>
+
 #include "ImageGray.hpp"
 
+// hint to load the cache line of #address# before it is written
+#ifdef __GNUC__
+# define PREFETCH(address) __builtin_prefetch( (address), 1 )
+#else
+# define PREFETCH(address)
+#endif
+
+class ImageDensity;
+
 class ElementColorMap {
 public:
     ElementColorMap() : c(0), r(0), g(0), b(0) {
@@ -41,7 +52,9 @@ public:
     /// empty constructor: set all the variables to 0
     Image();
 
-    Image( int w, int h, bool color, int wd = -1, int wh = -1, int start = -1 );
+    /// #withRgbTab# false for derived classes which store the colors themselves
+    Image( int w, int h, bool color, int wd = -1, int wh = -1, int start = -1,
+	   bool withRgbTab = true );
 
     ~Image();
 
@@ -54,12 +67,60 @@ public:
   
     virtual void mem_coul( int i, int j, float c );
 
+    /// prefetch the memory written by mem_plot and mem_coul for (i,j). range checking
+    virtual void prefetch( int i, int j ) const;
+
+    // { size of the coordinates given to mem_plot. larger than w() and h() for ImageSupersampled
+    virtual int plotW() const { return width; }
+    virtual int plotH() const { return height; }
+    // }
+
     /// return number of hit. used for julia orbits
     virtual int getHit( int i, int j ) const;
 
     /// draw the image in memory (tab)
     virtual void mem_draw() const;
 
+    /** rebuild tab and colorTab with the current color map and background,
+	then draw them. false if the colors are not kept apart from tab:
+	the image must be calculated again
+    */
+    virtual bool remap() const { return false; }
+
+    /// counters of the hits of the image. NULL if it has none. see Checkpoint
+    virtual ImageDensity* densityImage() { return NULL; }
+
+    /** number of hits of the pixels of tab before the tone mapping,
+	filtered by ImageDensity::densityFilter if active, to #density#
+	(w()*h() floats) and, if colored, their mean colors to #rgb#
+	(3*w()*h() floats). returns the maximum of #density#, or -1 if the
+	image does not count the hits of its pixels
+    */
+    virtual float getDensity( std::vector<float>& density, std::vector<float>& rgb ) const {
+	return -1;
+    }
+
+    /** prepare getDensityRow() and return the maximum density of the
+	pixels. -1 if the image does not count its hits or if
+	ImageDensity::densityFilter is active: the filter needs all the
+	rows, see getDensity
+    */
+    virtual float startDensityRows() const { return -1; }
+
+    /** density (w() floats) and, if colored, mean colors (3*w() floats)
+	of the row #y# after startDensityRows(), computed from the counters
+	without copying all of them. used to save the images row by row
+    */
+    virtual void getDensityRow( int y, float* density, float* rgb ) const {}
+
+    /** write the density of the pixels (see getDensity) to #f# in the
+	format PNG16 or PFM. The levels are tone mapped as in tab or, if
+	#linear#, proportional to the density: the number of hits (PFM) or
+	the number of hits divided by the maximum (PNG16), the background
+	being then always black. returns 1 if succeed, 0 if failed
+    */
+    int saveHDR( FILE* f, imageFormat format, bool linear, const std::string& description ) const;
+
     /// test if tab contains only 0. for debug purpose
     virtual bool isEmpty() const;
 
@@ -75,13 +136,25 @@ public:
 
     static void readDefinedMap( const int map );
 
+    /// color of the coordinate #c# in [0, 1] of the color map to #rgb#
+    static void colorOf( float c, float* rgb );
+
 protected:
     void copy( const Image& other );
 
     float* rgbTab;
 
+    /// add the color coordinate #c# to the pixel #n#. its color by default
+    virtual void plotCoordinate( int n, float c );
+
     virtual void plotColor( int n, float r, float g, float b );
 
+    /** build tab and colorTab from the #density# filtered by a DensityFilter
+	and the mean colors #rgb# (NULL if not colored), then draw them
+    */
+    void drawDensity( const std::vector<float>& density, const float* rgb,
+		      float maxDensity ) const;
+
 private:
     static std::vector<ElementColorMap> colorMap;
 
@@ -102,6 +175,117 @@ private:
 
 };
 
+/** buffer of the points to plot in an image, sorted by bins of
+    consecutive pixels. A bin is plotted in the image only when it is
+    full, so that its hits land in a part of the image which is in the
+    cache instead of random places of a large image.
+*/
+class PlotBins {
+public:
+    PlotBins() : image(NULL), width(0), height(0) {}
+
+    /// the next points are plotted in #image#. flush() must be called before
+    void bind( Image& image );
+
+    /// put (i,j) of color #c# in its bin. range checking
+    void plot( int i, int j, float c ) {
+	if ( 0 <= i && i < width && 0 <= j && j < height ) {
+	    const int b = ( i + j*width ) >> binShift;
+	    Point& p = points[ b*binCapacity + sizes[b] ];
+	    p.i = i;
+	    p.j = j;
+	    p.c = c;
+	    if ( ++sizes[b] == binCapacity ) {
+		flushBin(b);
+	    }
+	}
+    }
+
+    /// plot all the points of the bins in the image
+    void flush();
+
+    /// 2^14 pixels: the int counters of a bin (64 KB) stay in the L2 cache
+    static const int binShift = 14;
+
+    /// number of points of a bin: one bin is a few cache lines
+    static const int binCapacity = 64;
+
+private:
+    struct Point {
+	int i;
+	int j;
+	float c;
+    };
+
+    void flushBin( int b );
+
+    Image* image;
+    int width;
+    int height;
+
+    /// binCapacity points for each bin
+    std::vector<Point> points;
+
+    /// number of points in each bin
+    std::vector<int> sizes;
+};
+
+/** points waiting to be plotted in an image while the memory of their
+    pixel is prefetched: a point is plotted #distance# points after it
+    was given. Hides the latency of the memory for the images too large
+    for the caches but too small for PlotBins.
+*/
+class PlotPipeline {
+public:
+    /// #distance# is limited to maxDistance. 0: the points are plotted immediately
+    PlotPipeline( Image& image, int distance );
+
+    /// plot the waiting points
+    ~PlotPipeline() { flush(); }
+
+    /// prefetch (i,j) of color #c# and plot the point given #distance# points ago
+    void plot( int i, int j, float c ) {
+	if ( distance == 0 ) {
+	    image.mem_plot( i, j );
+	    image.mem_coul( i, j, c );
+	} else {
+	    Point& p = points[next];
+	    // the empty places are out of the image: mem_plot ignores them
+	    image.mem_plot( p.i, p.j );
+	    image.mem_coul( p.i, p.j, p.c );
+	    p.i = i;
+	    p.j = j;
+	    p.c = c;
+	    image.prefetch( i, j );
+	    if ( ++next == distance ) {
+		next = 0;
+	    }
+	}
+    }
+
+    /// plot all the waiting points
+    void flush();
+
+    static const int maxDistance = 64;
+
+private:
+    struct Point {
+	int i;
+	int j;
+	float c;
+    };
+
+    Image& image;
+
+    int distance;
+
+    /// ring buffer of the waiting points
+    Point points[maxDistance];
+
+    /// oldest point of #points#, replaced by the next one
+    int next;
+};
+
 class PseudoDensity {
 public:
     /// constructor. set logProbaHitMax to log(10000)
@@ -162,10 +346,81 @@ private:
 
 };
 
+/// how a density image stores the number of hits of its pixels
+enum HitCounters {
+    INT_COUNTERS,    // one int per pixel
+    COMPACT_COUNTERS, // 16 bits per pixel + table for the saturated pixels
+    LOG_COUNTERS,    // 8 bits per pixel, approximate counting
+    SPARSE_COUNTERS, // ints in 64x64 tiles allocated when first hit
+    BRICK_COUNTERS   // ints stored by 8x8 bricks: neighbour pixels are close in memory
+};
+
+/** logarithmic tone mapping of the density images:
+    level = 255 * log( 1 + hit) / log( 1 + maxHit )
+*/
+class ToneMap {
+public:
+    explicit ToneMap( int maxHit );
+
+    /// level in [0, 255] of a pixel hit #hits# times. #hits# may be filtered
+    int level( double hits ) const {
+	return std::lower_bound( nbHit.begin(), nbHit.end(), hits ) - nbHit.begin();
+    }
+
+    /// smallest number of hits of the pixels of level #l#
+    int hitsOf( int l ) const { return nbHit[l]; }
+
+    /** gray level and, if #rgb# is not NULL, color of a pixel hit #hits#
+	times whose mean color is #rgb#, according to the background
+    */
+    void pixel( double hits, const float* rgb, unsigned char& gray, unsigned char* color ) const;
+
+private:
+    /// nbHit[c] = (1+maxHit)^(c/255)
+    std::vector<int> nbHit;
+};
+
+/** adaptive density estimation: the hits of each pixel are spread by a
+    gaussian kernel whose radius decreases when the number of hits grows:
+    radius = maxRadius / hits^curve. The noise of the sparse regions is
+    smoothed while the dense regions keep their details, so fewer points
+    give a clean image. The pixels are grouped by radius and each group is
+    blurred by two separable passes shared between the processors.
+*/
+class DensityFilter {
+public:
+    /// constructor. maxRadius 0: no filter
+    DensityFilter();
+
+    void setMaxRadius( int r );
+    int getMaxRadius() const { return maxRadius; }
+
+    void setCurve( float c );
+    float getCurve() const { return curve; }
+
+    bool isActive() const { return maxRadius > 0; }
+
+    /** filter the #hits# of an image of size w*h to #density# (w*h floats)
+	and, if #rgb# is not NULL, replace the mean colors (3*w*h floats) by
+	the filtered ones. return the maximum of #density#
+    */
+    float apply( int w, int h, const int* hits, float* rgb, float* density ) const;
+
+    /// larger radii are slow and mostly blur the image
+    static const int maxMaxRadius = 16;
+
+private:
+    int maxRadius;
+
+    float curve;
+};
+
 /** the color of a pixel is set according to the number of times it was
     reached during the computation (number of hit).
     The formula applied is:
     gray = 255 * log( 1 + hit) / log( 1 + maxHit )
+    The mean coordinate in the color map is kept instead of the color:
+    the color map and the background can be changed by remap().
 */
 class ImageDensity : public Image {
 public:
@@ -184,7 +439,7 @@ public:
     /// put (i,j) in hitTab. range chcking
     void mem_plot( int i, int j );
 
-    virtual void plotColor( int n, float r, float g, float b );
+    void prefetch( int i, int j ) const;
 
     /// return number of hit. used for julia orbits
     int getHit( int i, int j ) const;
@@ -198,17 +453,480 @@ public:
     /// build tab from hitTab and draw it
     void mem_draw() const;
 
+    /// build all of tab from hitTab and draw it
+    bool remap() const;
+
+    ImageDensity* densityImage() { return this; }
+
+    float getDensity( std::vector<float>& density, std::vector<float>& rgb ) const;
+
+    float startDensityRows() const;
+
+    void getDensityRow( int y, float* density, float* rgb ) const;
+
+    int getMaxHit() const { return maxHit; }
+
+    /** copy the number of hits of the row #j# to #hits# (w() ints) and, if
+	#rgb# is not NULL, their mean colors to #rgb# (3*w() floats).
+	used to render the posters band by band
+    */
+    void getRow( int j, int* hits, float* rgb ) const;
+
+    /// copy the mean color coordinates of the row #j# to #coords# (w() floats, 0 if no hit)
+    void getCoordinates( int j, float* coords ) const;
+
+    /** set the number of hits of the row #j# to #hits# and, if colored,
+	their mean color coordinates to #coords#. maxHit is updated.
+	used to resume a calculation (see Checkpoint)
+    */
+    void setRow( int j, const int* hits, const float* coords );
+
+    /// max value for maxHit. maxint-1 because pow(1+maxInt,...)
+    static const int maxMaxHit;
+
+    /// applied by mem_draw before the tone mapping if active
+    static DensityFilter densityFilter;
+
+    // { to save hitCounters parameter to an XML file and to recover it
+    static std::string countersToXML( HitCounters counters );
+    static HitCounters countersFromXML( const std::string& s );
+    // }
+
+protected:
+    /** used by derived classes which store the hits themselves. hitTab is not allocated.
+	#withCoordTab# false for those which store the color coordinates too
+    */
+    ImageDensity( int w, int h, bool color, int wd, int hd, int s, bool withHitTab,
+		  bool withCoordTab = true );
+
+    /// empty constructor for the copy constructors of derived classes
+    ImageDensity() : maxHit(0), coordTab(NULL), hitTab(NULL) {}
+
+    /// number of hit of the pixel #n#. used by mem_draw and plotCoordinate
+    virtual int hitAt( int n ) const { return hitTab[n]; }
+
+    /// mean color coordinate of the pixel #n#. used by mem_draw
+    virtual float coordinateAt( int n ) const { return coordTab[n]; }
+
+    /// mean of the color coordinates of the hits
+    virtual void plotCoordinate( int n, float c );
+
+    /// set the number of hits and the color coordinate (if colored) of the pixel #n#
+    virtual void setPixel( int n, int hits, float coord );
+
+    /// copy coordTab. called by the copy of the derived classes
+    void copyCoordinates( const ImageDensity& other );
+
+    /// mem_draw with densityFilter
+    void drawFiltered() const;
+
+    int maxHit;
+
+    /// mean color coordinate of each pixel if colored. NULL if stored by a derived class
+    float* coordTab;
+
 private:
     /// number of hit for each pixel
     int* hitTab;
 
     /// called by constructors
     void copy(const ImageDensity& other );
+};
 
-    int maxHit;
+/** hash table of the number of hits of the pixels whose 16 bits counter
+    is saturated. Open addressing: there are only a few of these pixels.
+*/
+class HitOverflow {
+public:
+    HitOverflow();
 
-    /// max value for maxHit. maxint-1 because pow(1+maxInt,...)
-    static const int maxMaxHit;
+    /// return the number of hits of the pixel #n#. 0 if #n# is not in the table
+    int get( int n ) const;
+
+    /// set the number of hits of the pixel #n#
+    void set( int n, int hits );
+
+    void clear();
+
+    /// number of pixels in the table
+    int size() const { return count; }
+
+private:
+    /// position of #n# in keys, or of the empty slot where it should be inserted
+    int slot( int n ) const;
+
+    /// double the capacity of the table
+    void grow();
+
+    /// pixel index, or -1 for an empty slot
+    std::vector<int> keys;
+
+    std::vector<int> values;
+
+    int count;
+
+    /// 32 - log2 of the capacity: slot() keeps the top bits of the hash
+    int shift;
+};
+
+/** ImageDensity with 16 bits counters. A pixel hit more than 65534
+    times has its exact number of hit stored in a HitOverflow table.
+    Halves the memory used by the counters of the animations.
+*/
+class ImageCompactDensity : public ImageDensity {
+public:
+    /// create an image of size w*h
+    ImageCompactDensity( int w, int h, bool color, int wd = -1, int wh = -1, int s = -1 );
+
+    /// copy constructor. compactTab is copied.
+    ImageCompactDensity( const ImageCompactDensity& other ) { copy(other); }
+
+    /// free compactTab automatically
+    ~ImageCompactDensity();
+
+    /// constructor by affectation. frees the previous compactTab.
+    ImageCompactDensity& operator=( const ImageCompactDensity& other );
+
+    /// put (i,j) in compactTab. range chcking
+    void mem_plot( int i, int j );
+
+    void prefetch( int i, int j ) const;
+
+    /// return number of hit. used for julia orbits
+    int getHit( int i, int j ) const;
+
+    /// test if compactTab contains only 0. for debug purpose
+    bool isEmpty() const;
+
+    /// fill compactTab and tab with 0
+    void mem_clear();
+
+protected:
+    int hitAt( int n ) const {
+	return compactTab[n] == saturated ? overflow.get(n) : compactTab[n];
+    }
+
+    void setPixel( int n, int hits, float coord );
+
+private:
+    /// number of hit for each pixel. #saturated# if stored in #overflow#
+    unsigned short* compactTab;
+
+    /// exact number of hit of the saturated pixels
+    HitOverflow overflow;
+
+    static const unsigned short saturated = 0xffff;
+
+    /// called by constructors
+    void copy( const ImageCompactDensity& other );
+};
+
+/** ImageDensity whose counters (and colors) are stored in tiles of
+    #tileSize#*#tileSize# pixels, allocated when one of their pixels is
+    hit for the first time. The memory used by the counters grows with
+    the area covered by the fractal, not with the size of the image.
+*/
+class ImageSparseDensity : public ImageDensity {
+public:
+    /// create an image of size w*h. No tile is allocated
+    ImageSparseDensity( int w, int h, bool color, int wd = -1, int wh = -1, int s = -1 );
+
+    /// copy constructor. the tiles are copied.
+    ImageSparseDensity( const ImageSparseDensity& other ) { copy(other); }
+
+    /// free the tiles automatically
+    ~ImageSparseDensity();
+
+    /// constructor by affectation. frees the previous tiles.
+    ImageSparseDensity& operator=( const ImageSparseDensity& other );
+
+    /// put (i,j) in its tile. range chcking
+    void mem_plot( int i, int j );
+
+    /// nothing is prefetched in the tiles not allocated yet
+    void prefetch( int i, int j ) const;
+
+    /// return number of hit. used for julia orbits
+    int getHit( int i, int j ) const;
+
+    /// true if no tile is allocated
+    bool isEmpty() const;
+
+    /// free all the tiles and fill tab with 0
+    void mem_clear();
+
+    /// number of allocated tiles
+    int tilesUsed() const;
+
+    /// 64: a tile of ints fits in the L2 cache
+    static const int tileShift = 6;
+    static const int tileSize = 1 << tileShift;
+
+protected:
+    int hitAt( int n ) const {
+	const int* tile = hitTiles[ tileOf( n%width, n/width ) ];
+	return tile == NULL ? 0 : tile[ inTile( n%width, n/width ) ];
+    }
+
+    float coordinateAt( int n ) const {
+	return coordTiles[ tileOf( n%width, n/width ) ][ inTile( n%width, n/width ) ];
+    }
+
+    void plotCoordinate( int n, float c );
+
+    /// the tile of the pixel is allocated if #hits# is not 0
+    void setPixel( int n, int hits, float coord );
+
+private:
+    // { position of the pixel (i,j) in the tables of tiles and in its tile
+    int tileOf( int i, int j ) const { return (i >> tileShift) + (j >> tileShift)*tilesX; }
+    int inTile( int i, int j ) const { return (i & (tileSize-1)) + ((j & (tileSize-1)) << tileShift); }
+    // }
+
+    /// allocate the tile #t# (and its colors)
+    void allocateTile( int t );
+
+    void freeTiles();
+
+    /// number of tiles in a row
+    int tilesX;
+
+    /// counters of the tiles. NULL if the tile was never hit
+    std::vector<int*> hitTiles;
+
+    /// mean color coordinates of the tiles if the image is colored
+    std::vector<float*> coordTiles;
+
+    /// called by constructors
+    void copy( const ImageSparseDensity& other );
+};
+
+/** ImageDensity whose counters (and colors) are stored by bricks of
+    8x8 pixels instead of rows. The successive points of an orbit are
+    often close in the plane: they hit the same bricks, so the same
+    cache lines, instead of pixels one row (width ints) apart.
+    The rows are rebuilt only by mem_draw.
+*/
+class ImageBrickDensity : public ImageDensity {
+public:
+    /// create an image of size w*h. The size of the tables is rounded to whole bricks
+    ImageBrickDensity( int w, int h, bool color, int wd = -1, int wh = -1, int s = -1 );
+
+    /// copy constructor. the bricks are copied.
+    ImageBrickDensity( const ImageBrickDensity& other ) { copy(other); }
+
+    /// free the bricks automatically
+    ~ImageBrickDensity();
+
+    /// constructor by affectation. frees the previous bricks.
+    ImageBrickDensity& operator=( const ImageBrickDensity& other );
+
+    /// put (i,j) in its brick. range chcking
+    void mem_plot( int i, int j );
+
+    void prefetch( int i, int j ) const;
+
+    /// return number of hit. used for julia orbits
+    int getHit( int i, int j ) const;
+
+    /// test if brickTab contains only 0. for debug purpose
+    bool isEmpty() const;
+
+    /// fill brickTab and tab with 0
+    void mem_clear();
+
+    /// 8: a row of a brick of ints is half a cache line, a brick is 4 cache lines
+    static const int brickShift = 3;
+    static const int brickSize = 1 << brickShift;
+
+protected:
+    int hitAt( int n ) const { return brickTab[ brickIndex( n%width, n/width ) ]; }
+
+    float coordinateAt( int n ) const { return brickCoord[ brickIndex( n%width, n/width ) ]; }
+
+    void plotCoordinate( int n, float c );
+
+    void setPixel( int n, int hits, float coord );
+
+private:
+    /// position of the pixel (i,j) in brickTab
+    int brickIndex( int i, int j ) const {
+	return ( ( (i >> brickShift) + (j >> brickShift)*bricksX ) << (2*brickShift) )
+	    + ( (j & (brickSize-1)) << brickShift ) + ( i & (brickSize-1) );
+    }
+
+    /// number of bricks in a row
+    int bricksX;
+
+    /// size of brickTab: sizePixels rounded to whole bricks
+    int sizeBricks;
+
+    /// number of hit for each pixel, brick after brick
+    int* brickTab;
+
+    /// mean color coordinate of each pixel in the order of brickTab. NULL if not colored
+    float* brickCoord;
+
+    /// called by constructors
+    void copy( const ImageBrickDensity& other );
+};
+
+/** density image calculated #factor# times larger in both directions
+    and reduced by a box filter when it is drawn: the edges are
+    anti-aliased without saving a larger image. mem_plot, mem_coul and
+    getHit take the coordinates of the large image (plotW() x plotH()).
+    The reduction is shared between the processors (see Parallel).
+*/
+class ImageSupersampled : public Image {
+public:
+    /** #fine# of size (factor*w) x (factor*h), extra pixels ignored.
+	#fine# is deleted by the destructor
+    */
+    ImageSupersampled( ImageDensity* fine, int factor, int wd = -1, int wh = -1, int s = -1 );
+
+    ~ImageSupersampled();
+
+    void mem_plot( int i, int j ) { fine->mem_plot( i, j ); }
+
+    void mem_coul( int i, int j, float c ) { fine->mem_coul( i, j, c ); }
+
+    void prefetch( int i, int j ) const { fine->prefetch( i, j ); }
+
+    int plotW() const { return fine->w(); }
+    int plotH() const { return fine->h(); }
+
+    ImageDensity* densityImage() { return fine; }
+
+    /// density of the pixels after the reduction
+    float getDensity( std::vector<float>& density, std::vector<float>& rgb ) const;
+
+    /// reduce all the image to sumTab and rgbTab
+    float startDensityRows() const;
+
+    /// row of sumTab and rgbTab
+    void getDensityRow( int y, float* density, float* rgb ) const;
+
+    /// number of hit of the pixel (i,j) of the large image. used for julia orbits
+    int getHit( int i, int j ) const { return fine->getHit( i, j ); }
+
+    bool isEmpty() const { return fine->isEmpty(); }
+
+    /// clear tab and the large image
+    void mem_clear();
+
+    /// reduce the large image to tab and draw it
+    void mem_draw() const;
+
+    bool remap() const { mem_draw(); return true; }
+
+    /// 4: 16 times the memory of the counters
+    static const int maxFactor = 4;
+
+private:
+    /// not copied: the animations do not use supersampling
+    ImageSupersampled( const ImageSupersampled& );
+    ImageSupersampled& operator=( const ImageSupersampled& );
+
+    ImageDensity* fine;
+
+    int factor;
+
+    /// number of hits of the pixels after the reduction
+    int* sumTab;
+};
+
+/** Morris approximate counter stored in 8 bits.
+    A counter #c# represents estimate(c) = (base^c - 1) / (base - 1) hits
+    and is incremented with the probability base^-c, which makes
+    estimate(c) an unbiased estimation of the number of hits.
+    The relative standard deviation is about sqrt((base-1)/2).
+*/
+class MorrisCounter {
+public:
+    /// constructor. set base to 1.08: 255 counts more than 2^31 hits
+    MorrisCounter();
+
+    void setBase( float b );
+    float getBase() const { return base; }
+
+    /// estimation of the number of hits of a counter equal to #c#
+    int estimate( unsigned char c ) const { return estimates[c]; }
+
+    /// counter whose estimation is the closest to #hits#
+    unsigned char counter( int hits ) const;
+
+    /// return true if a counter equal to #c# should be incremented. #random# is uniform
+    bool increment( unsigned char c, unsigned int random ) const {
+	return c < 255 && random <= thresholds[c];
+    }
+
+private:
+    float base;
+
+    int estimates[256];
+
+    /// probability of increment multiplied by 2^32
+    unsigned int thresholds[256];
+
+};
+
+/** ImageDensity with one byte per pixel: the hits are counted by
+    Morris approximate counters. Uses a quarter of the memory of
+    ImageDensity for the counters.
+*/
+class ImageLogDensity : public ImageDensity {
+public:
+    static MorrisCounter morrisCounter;
+
+    /// create an image of size w*h
+    ImageLogDensity( int w, int h, bool color, int wd = -1, int wh = -1, int s = -1 );
+
+    /// copy constructor. logTab is copied.
+    ImageLogDensity( const ImageLogDensity& other ) { copy(other); }
+
+    /// free logTab automatically
+    ~ImageLogDensity();
+
+    /// constructor by affectation. frees the previous logTab.
+    ImageLogDensity& operator=( const ImageLogDensity& other );
+
+    /// increment the counter of (i,j) with the probability given by morrisCounter
+    void mem_plot( int i, int j );
+
+    void prefetch( int i, int j ) const;
+
+    /// return the estimated number of hit. used for julia orbits
+    int getHit( int i, int j ) const;
+
+    /// test if logTab contains only 0. for debug purpose
+    bool isEmpty() const;
+
+    /// fill logTab and tab with 0
+    void mem_clear();
+
+protected:
+    int hitAt( int n ) const { return morrisCounter.estimate( logTab[n] ); }
+
+    /// #hits# is rounded to the closest estimation of a counter
+    void setPixel( int n, int hits, float coord );
+
+private:
+    /// Morris counter of each pixel
+    unsigned char* logTab;
+
+    /// state of the xorshift generator used to increment the counters
+    unsigned int randomState;
+
+    /// xorshift32: much faster than rand()
+    unsigned int nextRandom() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+    }
+
+    /// called by constructors
+    void copy( const ImageLogDensity& other );
 };
 
 #endif // IMAGE_HPP
@@ -21,7 +21,12 @@ USA.
 #endif
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+// strlen, memcpy
+
+#include <zlib.h>
 
 #include <FL/Fl_Window.H>
 #include <FL/Fl.H>
@@ -29,6 +34,7 @@ USA.
 
 #include "ImageGray.hpp"
 #include "Image.hpp"
+#include "Parallel.hpp"
 
 #ifdef ENABLE_NLS
 # include <libintl.h>
@@ -37,7 +43,10 @@ USA.
 # define _(String) (String)
 #endif
 
-Progress::Progress( const char* title, const int max ) {
+Progress::Progress( const char* title, const int max ) : w(NULL), p(NULL) {
+    if ( !enabled ) {
+	return;
+    }
     w = new Fl_Window( width, height, title );
     p = new Fl_Progress( border, border, width - 2*border, height - 2*border );
     p->minimum(0);
@@ -53,10 +62,15 @@ Progress::~Progress() {
 
 void
 Progress::setValue( const float f ) {
-    p->value(f);
-    Fl::wait(0);
+    if ( p != NULL ) {
+	p->value(f);
+	Fl::wait(0);
+    }
 }
 
+bool
+Progress::enabled = true;
+
 const std::string
 Transparency::xmlSimple = "one color";
 const std::string
@@ -109,6 +123,29 @@ Transparency::setTransparencyFromXML( const std::string& s ) {
     }
 }
 
+void
+PngCompression::setLevel( const int l ) {
+    level = std::min( std::max( l, 0 ), 9 );
+}
+
+namespace {
+    const char* const filterNames[] = { "none", "sub", "up", "average", "paeth", "adaptive" };
+}
+
+std::string
+PngCompression::filterToXML() const {
+    return filterNames[filter];
+}
+
+void
+PngCompression::setFilterFromXML( const std::string& s ) {
+    for ( int f = NONE; f <= ADAPTIVE; ++f ) {
+	if ( s == filterNames[f] ) {
+	    filter = (Filter)f;
+	}
+    }
+}
+
 const std::string
 ImageGray::software = std::string("Glito (c) 2002-2003 Emmanuel Debanne http://www.debanne.net/glito. ") + _("Glito is free software.");
 
@@ -118,6 +155,9 @@ ImageGray::background = Background();
 Transparency
 ImageGray::transparency = Transparency();
 
+PngCompression
+ImageGray::pngCompression = PngCompression();
+
 const std::string
 ImageGray::formatToString( imageFormat f ) {
     switch ( f ) {
@@ -126,6 +166,10 @@ ImageGray::formatToString( imageFormat f ) {
     case BMPG: return "BMP gray-level";
     case PNG: return "PNG gray-level";
     case MNG: return "MNG gray-level";
+    case PNG16: return "PNG 16 bits";
+    case PFM: return "PFM";
+    case APNG: return "APNG";
+    case VIDEO: return "Video";
     default: return "unknown";
     }
 }
@@ -257,32 +301,53 @@ ImageGray::save( std::ofstream& f, const imageFormat format ) const {
 
 void
 ImageGray::save_addition_pgm( std::ofstream& f ) const {
-    for ( int i = 0; i < sizePixels; ++i ) {
-	f << tab[i];
+    f.write( (const char*)tab, sizePixels );
+}
+
+namespace {
+    /// 8 pixels of a bitmap: the bit 7-k is set if gray[k] is not 0
+    inline unsigned char packBits( const unsigned char* gray, const bool littleEndian ) {
+	if ( littleEndian ) {
+	    // the 8 pixels at once: the highest bit of each byte is set
+	    // if the byte is not 0, then these bits are gathered by the
+	    // multiplication in the highest byte, the first pixel first
+	    const unsigned long long low = 0x7f7f7f7f7f7f7f7fULL;
+	    unsigned long long v;
+	    memcpy( &v, gray, 8 );
+	    v = ( ( ( v & low ) + low ) | v ) & ~low;
+	    return (unsigned char)( ( ( v >> 7 ) * 0x8040201008040201ULL ) >> 56 );
+	}
+	unsigned char c = 0;
+	for ( int k = 0; k < 8; ++k ) {
+	    c |= ( gray[k] != 0 ) << (7-k);
+	}
+	return c;
     }
 }
 
 void
 ImageGray::save_addition_bmpb( std::ofstream& f ) const {
     Progress progress( _("Saving BMP file"), height );
+    const int one = 1;
+    const bool littleEndian = *(const char*)&one == 1;
     const int horizontalSizeBits = w() + (( 32 - (w()%32) )%32);
+    // the padding bits stay 0
+    std::vector<unsigned char> row( horizontalSizeBits / 8, 0 );
     for ( int y = height-1; y >= 0; --y ) {
 	progress.setValue(height-y);
+	const unsigned char* gray = tab + y*w();
 	int x = 0;
-	for ( ; x < w(); x+=8 ) {
-	    const int i = x + y*w();
-	    int c = 0;
-	    for ( int k = 0; k < 8; ++k ) {
-		if ( x + k < w() ) {
-		    c += ( 1<<(7-k) )*( tab[i+k] != 0 );
-		}
-	    }
-	    // bug of mingw: occurs when the two lowest bits of c are not 0
-	    f << (unsigned char)c;
+	for ( ; x + 8 <= w(); x+=8 ) {
+	    row[x/8] = packBits( gray + x, littleEndian );
 	}
-	for ( ; x < horizontalSizeBits; x+=8 ) {
-	    f << (unsigned char)0;
+	if ( x < w() ) {
+	    unsigned char last[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	    std::copy( gray + x, gray + w(), last );
+	    row[x/8] = packBits( last, littleEndian );
 	}
+	// bug of mingw: occurs when the two lowest bits of a byte are not 0
+	// with operator<<. write() copies the bytes as they are
+	f.write( (const char*)&row[0], row.size() );
     }
 }
 
@@ -290,23 +355,647 @@ void
 ImageGray::save_addition_bmpg( std::ofstream& f ) const {
     Progress progress( _("Saving BMP file"), height );
     const int horizontalSizeBytes = w() + (( 4 - (w()%4) )%4);
+    // the padding bytes stay 0
+    std::vector<unsigned char> row( horizontalSizeBytes, 0 );
     for ( int y = height-1; y >= 0; --y ) {
 	progress.setValue(height-y);
-	int x = 0;
-	for ( ; x < w(); ++x ) {
-	    const int i = x + y*w();
-	    f << tab[i];
+	std::copy( tab + y*w(), tab + (y+1)*w(), row.begin() );
+	f.write( (const char*)&row[0], row.size() );
+    }
+}
+
+#ifdef HAVE_LIBPNG
+namespace {
+    /// rows of tab and colorTab
+    class TabRows : public ImageRows {
+    public:
+	TabRows( const unsigned char* tab, const unsigned char* colorTab, int width )
+	    : tab(tab), colorTab(colorTab), width(width) {}
+
+	void getRow( int y, unsigned char* gray, unsigned char* color ) {
+	    std::copy( tab + y*width, tab + (y+1)*width, gray );
+	    if ( colorTab != NULL ) {
+		std::copy( colorTab + 3*y*width, colorTab + 3*(y+1)*width, color );
+	    }
 	}
-	for ( ; x < horizontalSizeBytes; ++x ) {
-	    f << (unsigned char)0;
+
+    private:
+	const unsigned char* tab;
+	const unsigned char* colorTab;
+	const int width;
+    };
+
+    /// comments into the PNG image: software and #description#
+    void setText( png_structp png_ptr, png_infop info_ptr, const std::string& description ) {
+	const int text_ptr_size = 2;
+	png_text text_ptr[text_ptr_size];
+	text_ptr[0].key = "Software";
+	char soft[ImageGray::software.size()+1];
+	ImageGray::software.copy( soft, ImageGray::software.size() );
+	soft[ImageGray::software.size()] = '\0';
+	text_ptr[0].text = soft;
+	text_ptr[0].compression = PNG_TEXT_COMPRESSION_NONE;
+	text_ptr[1].key = "Description";
+	char desc[description.size()+1];
+	description.copy( desc, description.size() );
+	desc[description.size()]='\0';
+	text_ptr[1].text = desc;
+	// As it is difficult to find a ImageGray::software which can retrieve a compressed
+	// text in a PNG file, compression is not used for the moment.
+	// text_ptr[1].compression = PNG_TEXT_COMPRESSION_zTXt;
+	text_ptr[1].compression = PNG_TEXT_COMPRESSION_NONE;
+	png_set_text( png_ptr, info_ptr, text_ptr, text_ptr_size );
+    }
+
+    /// rows converted to the bytes of a PNG file
+    class PngRows {
+    public:
+	virtual ~PngRows() {}
+
+	virtual void getRow( int y, png_byte* row ) = 0;
+    };
+
+    /// 8 bits rows of the gray levels and colors of #rows#, with the transparency
+    class EightBitRows : public PngRows {
+    public:
+	EightBitRows( ImageRows& rows, int width, bool colored )
+	    : rows(rows), width(width), colored(colored),
+	      gray( width ), color( colored ? 3*width : 0 ) {}
+
+	/// bytes of a pixel in the file
+	int pixelBytes() const {
+	    return (ImageGray::transparency.useAlphaTransparency() ? 1 : 0) + (colored ? 3 : 1);
+	}
+
+	void getRow( int y, png_byte* row ) {
+	    const Background& background = ImageGray::background;
+	    const bool alpha = ImageGray::transparency.useAlphaTransparency();
+	    const int bytes_per_pixel = pixelBytes();
+	    rows.getRow( y, &gray[0], colored ? &color[0] : NULL );
+	    for ( int x = 0; x < width; ++x ) {
+		const int posImage = bytes_per_pixel * x;
+		if ( alpha ) {
+		    if ( colored ) {
+			row[posImage    ] = color[3*x];
+			row[posImage + 1] = color[3*x + 1];
+			row[posImage + 2] = color[3*x + 2];
+			if ( background.isBlack() ) {
+			    row[posImage + 3] = gray[x];
+			} else {
+			    row[posImage + 3] = 255 - gray[x];
+			}
+		    } else {
+			row[posImage] = background.getFull();
+			row[posImage + 1] = 255 - gray[x];
+		    }
+		} else {
+		    if ( colored ) {
+			row[posImage] = color[3*x];
+			row[posImage + 1] = color[3*x + 1];
+			row[posImage + 2] = color[3*x + 2];
+		    } else {
+			row[posImage] = gray[x];
+		    }
+		}
+	    }
+	}
+
+    private:
+	ImageRows& rows;
+	const int width;
+	const bool colored;
+	std::vector<unsigned char> gray;
+	std::vector<unsigned char> color;
+    };
+
+    /// 16 bits rows of the levels of #rows#
+    class SixteenBitRows : public PngRows {
+    public:
+	SixteenBitRows( HdrRows& rows, int width, bool colored )
+	    : rows(rows), samples( ( colored ? 3 : 1 ) * width ) {}
+
+	void getRow( int y, png_byte* row ) {
+	    rows.getRow( y, &samples[0] );
+	    for ( size_t k = 0; k < samples.size(); ++k ) {
+		const float v = std::min( std::max( samples[k], 0.0f ), 1.0f );
+		const unsigned int level = (unsigned int)( v * 65535 + 0.5 );
+		// PNG is big endian
+		row[2*k    ] = (png_byte)( level >> 8 );
+		row[2*k + 1] = (png_byte)( level & 0xff );
+	    }
+	}
+
+    private:
+	HdrRows& rows;
+	std::vector<float> samples;
+    };
+
+    /// receives the bands of converted rows of a PNG file, in order
+    class PngBands {
+    public:
+	virtual ~PngBands() {}
+
+	/// the rows from #begin# to #end# (excluded), one after the other in #data#
+	virtual void band( int begin, int end, const png_byte* data ) = 0;
+    };
+
+    /// rows compressed by libpng
+    class LibpngBands : public PngBands {
+    public:
+	LibpngBands( png_structp png_ptr, int rowBytes ) : png_ptr(png_ptr), rowBytes(rowBytes) {}
+
+	void band( int begin, int end, const png_byte* data ) {
+	    for ( int y = begin; y < end; ++y ) {
+		png_write_row( png_ptr, (png_bytep)data + (size_t)(y - begin) * rowBytes );
+	    }
+	}
+
+    private:
+	png_structp png_ptr;
+	const int rowBytes;
+    };
+
+    /** gives the rows of a PNG file by bands: while a band is compressed
+	by the calling thread, the next one is converted by a second thread
+	(see Parallel::Background). Only two bands are in memory.
+	Must be built before the setjmp of libpng: its destructor waits for
+	the second thread if png_write_row fails.
+    */
+    class PngPipeline : public BackgroundTask {
+    public:
+	/// bandRows 0: bands of about 256 KB
+	PngPipeline( PngRows& rows, int rowBytes, int height, int bandRows = 0 )
+	    : rows(rows), rowBytes(rowBytes), height(height),
+	      bandRows( std::max( 1, std::min( height, bandRows > 0 ? bandRows
+					       : (1 << 18) / std::max( rowBytes, 1 ) ) ) ),
+	      filled(0), first(0) {
+	    bands[0].resize( (size_t)this->bandRows * rowBytes );
+	    bands[1].resize( (size_t)this->bandRows * rowBytes );
+	}
+
+	/// #progress# is set to #progressOffset# plus the row written
+	void write( PngBands& sink, Progress& progress, int progressOffset = 0 ) {
+	    filled = 0;
+	    first = 0;
+	    converter.start( *this );
+	    for ( int begin = 0; begin < height; begin += bandRows ) {
+		converter.wait();
+		const int current = filled;
+		const int end = std::min( begin + bandRows, height );
+		if ( end < height ) {
+		    filled = 1 - current;
+		    first = end;
+		    converter.start( *this );
+		}
+		progress.setValue( progressOffset + begin );
+		sink.band( begin, end, &bands[current][0] );
+	    }
+	}
+
+	/// called by the second thread: converts the band #filled# from the row #first#
+	void run() {
+	    const int end = std::min( first + bandRows, height );
+	    for ( int y = first; y < end; ++y ) {
+		rows.getRow( y, &bands[filled][ (size_t)(y - first) * rowBytes ] );
+	    }
+	}
+
+    private:
+	PngRows& rows;
+	const int rowBytes;
+	const int height;
+	const int bandRows;
+	std::vector<png_byte> bands[2];
+	int filled;
+	int first;
+	/// last member: destroyed first, so the conversion ends before the bands are freed
+	Parallel::Background converter;
+    };
+
+    /// filter type of PNG of #f#. see PngCompression
+    int libpngFilter( PngCompression::Filter f ) {
+	switch ( f ) {
+	case PngCompression::NONE: return PNG_FILTER_NONE;
+	case PngCompression::SUB: return PNG_FILTER_SUB;
+	case PngCompression::UP: return PNG_FILTER_UP;
+	case PngCompression::AVERAGE: return PNG_FILTER_AVG;
+	case PngCompression::PAETH: return PNG_FILTER_PAETH;
+	default: return PNG_ALL_FILTERS;
 	}
     }
+
+    /** PNG file written without libpng (see PngCompression::isParallel):
+	the filtered rows are split in chunks of about 128 KB compressed at
+	the same time (see Parallel::rows) by independent raw deflate
+	streams, each with the end of the previous chunk as dictionary. All
+	the streams but the last end with a sync flush: their concatenation
+	is the zlib stream of the IDAT chunks, as with pigz.
+	An animated PNG (APNG) holds several images: the first one in the
+	IDAT chunks, the next ones in fdAT chunks, each one after its fcTL.
+    */
+    class ChunkedPng : public PngBands, public RowTask {
+    public:
+	ChunkedPng( FILE* fp, int rowBytes, int pixelBytes, int height )
+	    : fp(fp), width(0), rowBytes(rowBytes), pixelBytes(pixelBytes), height(height),
+	      chunkRows( std::max( 1, (1 << 17) / rowBytes ) ),
+	      level( ImageGray::pngCompression.getLevel() ),
+	      filterType( ImageGray::pngCompression.getFilter() ),
+	      parallel( ImageGray::pngCompression.isParallel() ),
+	      images(0), sequence(-1), adler( adler32( 0, NULL, 0 ) ), failed(false) {}
+
+	/// rows given to band(): two chunks for each thread
+	int bandRows() const { return chunkRows * 2 * Parallel::threads(); }
+
+	/** signature, header, number of #frames# of an animation (0: not
+	    animated), texts and transparent color (if not NULL).
+	    false if the writing failed
+	*/
+	bool writeHeader( int w, int bitDepth, int colorType, const std::string& description,
+			  const png_color_16* transparent, int frames = 0 ) {
+	    static const png_byte signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	    width = w;
+	    png_byte header[13];
+	    putInt( header, width );
+	    putInt( header + 4, height );
+	    header[8] = (png_byte)bitDepth;
+	    header[9] = (png_byte)colorType;
+	    header[10] = 0; // deflate
+	    header[11] = 0; // adaptive filtering
+	    header[12] = 0; // no interlace
+	    failed = fwrite( signature, 1, 8, fp ) != 8
+		|| !writeChunk( "IHDR", header, sizeof(header) );
+	    if ( frames > 0 && !failed ) {
+		png_byte animation[8];
+		putInt( animation, frames );
+		putInt( animation + 4, 0 ); // played forever
+		failed = !writeChunk( "acTL", animation, sizeof(animation) );
+		sequence = 0;
+	    }
+	    failed = failed
+		|| !writeText( "Software", ImageGray::software )
+		|| !writeText( "Description", description );
+	    if ( transparent != NULL && !failed ) {
+		png_byte trns[6];
+		const bool gray = ( colorType == PNG_COLOR_TYPE_GRAY );
+		putShort( trns, gray ? transparent->gray : transparent->red );
+		putShort( trns + 2, transparent->green );
+		putShort( trns + 4, transparent->blue );
+		failed = !writeChunk( "tRNS", trns, gray ? 2 : 6 );
+	    }
+	    return !failed;
+	}
+
+	/** starts the zlib stream of an image, after its frame control if
+	    the PNG is animated: shown #delay# milli-seconds, replacing the
+	    previous frame. false if the writing failed
+	*/
+	bool startImage( int delay = 0 ) {
+	    if ( sequence >= 0 && !failed ) {
+		png_byte control[26];
+		putInt( control, sequence++ );
+		putInt( control + 4, width );
+		putInt( control + 8, height );
+		putInt( control + 12, 0 ); // x offset
+		putInt( control + 16, 0 ); // y offset
+		putShort( control + 20, std::min( std::max( delay, 0 ), 65535 ) );
+		putShort( control + 22, 1000 ); // delay in milli-seconds
+		control[24] = 0; // dispose: none
+		control[25] = 0; // blend: source, the transparent pixels too
+		failed = !writeChunk( "fcTL", control, sizeof(control) );
+	    }
+	    ++images;
+	    adler = adler32( 0, NULL, 0 );
+	    previousRow.clear();
+	    dictionary.clear();
+	    // zlib header: deflate with a 32 KB window, then the level and the check bits
+	    const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+	    png_byte zlibHeader[2] = { 0x78, (png_byte)( flevel << 6 ) };
+	    zlibHeader[1] += 31 - ( 0x78 * 256 + zlibHeader[1] ) % 31;
+	    failed = failed || !writeData( zlibHeader, 2 );
+	    return !failed;
+	}
+
+	void band( int b, int e, const png_byte* d ) {
+	    if ( failed ) {
+		return;
+	    }
+	    begin = b;
+	    end = e;
+	    data = d;
+	    const int chunks = ( end - begin + chunkRows - 1 ) / chunkRows;
+	    filtered.resize( chunks );
+	    compressed.resize( chunks );
+	    adlers.resize( chunks );
+	    compressing = false;
+	    if ( parallel ) {
+		Parallel::rows( *this, chunks );
+	    } else {
+		rows( 0, chunks );
+	    }
+	    compressing = true;
+	    if ( parallel ) {
+		Parallel::rows( *this, chunks );
+	    } else {
+		rows( 0, chunks );
+	    }
+	    for ( int c = 0; c < chunks && !failed; ++c ) {
+		failed = !writeData( &compressed[c][0], compressed[c].size() );
+		adler = adler32_combine( adler, adlers[c], filtered[c].size() );
+	    }
+	    // for the first chunk of the next band
+	    const std::vector<png_byte>& last = filtered[chunks-1];
+	    dictionary.assign( last.end() - std::min( last.size(), (size_t)windowSize ), last.end() );
+	    previousRow.assign( data + (size_t)(end - 1 - begin) * rowBytes,
+				data + (size_t)(end - begin) * rowBytes );
+	}
+
+	/// filters (first call of Parallel::rows) or compresses the chunks from #first# to #last#
+	void rows( int first, int last ) {
+	    for ( int c = first; c < last; ++c ) {
+		if ( compressing ) {
+		    compress( c );
+		} else {
+		    filter( c );
+		}
+	    }
+	}
+
+	/// adler32 of the zlib stream of the image. false if the writing failed
+	bool endImage() {
+	    png_byte trailer[4];
+	    putInt( trailer, adler );
+	    failed = failed || !writeData( trailer, 4 );
+	    return !failed;
+	}
+
+	/// end of the file. false if the writing failed
+	bool writeEnd() {
+	    return !failed && writeChunk( "IEND", NULL, 0 );
+	}
+
+    private:
+	/// size of the deflate window
+	static const int windowSize = 32768;
+
+	void filter( int c ) {
+	    const int first = begin + c*chunkRows;
+	    const int last = std::min( first + chunkRows, end );
+	    std::vector<png_byte>& out = filtered[c];
+	    out.resize( (size_t)(last - first) * (rowBytes + 1) );
+	    std::vector<png_byte> candidate( filterType == PngCompression::ADAPTIVE ? rowBytes + 1 : 0 );
+	    for ( int y = first; y < last; ++y ) {
+		const png_byte* row = data + (size_t)(y - begin) * rowBytes;
+		const png_byte* previous = ( y > begin ) ? row - rowBytes
+		    : ( previousRow.empty() ? NULL : &previousRow[0] );
+		png_byte* o = &out[ (size_t)(y - first) * (rowBytes + 1) ];
+		if ( filterType != PngCompression::ADAPTIVE ) {
+		    filterRow( filterType, row, previous, o );
+		    continue;
+		}
+		// the filter whose bytes have the smallest sum, as signed bytes
+		long best = -1;
+		for ( int f = PngCompression::NONE; f < PngCompression::ADAPTIVE; ++f ) {
+		    filterRow( f, row, previous, &candidate[0] );
+		    long sum = 0;
+		    for ( int i = 1; i <= rowBytes; ++i ) {
+			sum += std::abs( (int)(signed char)candidate[i] );
+		    }
+		    if ( best < 0 || sum < best ) {
+			best = sum;
+			std::copy( candidate.begin(), candidate.end(), o );
+		    }
+		}
+	    }
+	    adlers[c] = adler32( adler32( 0, NULL, 0 ), &out[0], out.size() );
+	}
+
+	/// filter #f# of #row# to #out# (the filter type then the rowBytes bytes)
+	void filterRow( int f, const png_byte* row, const png_byte* previous, png_byte* out ) const {
+	    out[0] = (png_byte)f;
+	    for ( int i = 0; i < rowBytes; ++i ) {
+		const int a = i >= pixelBytes ? row[i - pixelBytes] : 0;
+		const int b = previous != NULL ? previous[i] : 0;
+		const int c = previous != NULL && i >= pixelBytes ? previous[i - pixelBytes] : 0;
+		int predictor;
+		switch ( f ) {
+		case PngCompression::SUB: predictor = a; break;
+		case PngCompression::UP: predictor = b; break;
+		case PngCompression::AVERAGE: predictor = ( a + b ) / 2; break;
+		case PngCompression::PAETH: {
+		    const int p = a + b - c;
+		    const int pa = std::abs( p - a );
+		    const int pb = std::abs( p - b );
+		    const int pc = std::abs( p - c );
+		    predictor = ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ? b : c );
+		    break;
+		}
+		default: predictor = 0;
+		}
+		out[i + 1] = (png_byte)( row[i] - predictor );
+	    }
+	}
+
+	void compress( int c ) {
+	    const std::vector<png_byte>& in = filtered[c];
+	    std::vector<png_byte>& out = compressed[c];
+	    z_stream z;
+	    z.zalloc = Z_NULL;
+	    z.zfree = Z_NULL;
+	    z.opaque = Z_NULL;
+	    // raw deflate: the zlib header and trailer are written once for all the chunks
+	    if ( deflateInit2( &z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+		failed = true;
+		return;
+	    }
+	    const std::vector<png_byte>& previous = c > 0 ? filtered[c-1] : dictionary;
+	    const size_t d = std::min( previous.size(), (size_t)windowSize );
+	    if ( d > 0 ) {
+		deflateSetDictionary( &z, &previous[ previous.size() - d ], d );
+	    }
+	    const bool lastChunk = ( end == height && c == (int)filtered.size() - 1 );
+	    // the bound does not count the empty block of the flush
+	    out.resize( deflateBound( &z, in.size() ) + 16 );
+	    z.next_in = (Bytef*)&in[0];
+	    z.avail_in = in.size();
+	    z.next_out = &out[0];
+	    z.avail_out = out.size();
+	    int result;
+	    while ( ( result = deflate( &z, lastChunk ? Z_FINISH : Z_SYNC_FLUSH ) ) == Z_OK
+		    && z.avail_out == 0 ) {
+		const size_t done = out.size();
+		out.resize( 2 * done );
+		z.next_out = &out[done];
+		z.avail_out = out.size() - done;
+	    }
+	    if ( result != ( lastChunk ? Z_STREAM_END : Z_OK ) ) {
+		failed = true;
+	    }
+	    out.resize( z.total_out );
+	    deflateEnd( &z );
+	}
+
+	/// chunk whose data is the 4 bytes #prefix# (if not NULL) then #chunk#
+	bool writeChunk( const char* type, const png_byte* chunk, size_t size,
+			 const png_byte* prefix = NULL ) {
+	    const size_t prefixSize = prefix != NULL ? 4 : 0;
+	    png_byte length[4];
+	    putInt( length, prefixSize + size );
+	    uLong crc = crc32( 0, (const Bytef*)type, 4 );
+	    if ( prefixSize > 0 ) {
+		crc = crc32( crc, prefix, prefixSize );
+	    }
+	    if ( size > 0 ) {
+		crc = crc32( crc, chunk, size );
+	    }
+	    png_byte check[4];
+	    putInt( check, crc );
+	    return fwrite( length, 1, 4, fp ) == 4 && fwrite( type, 1, 4, fp ) == 4
+		&& ( prefixSize == 0 || fwrite( prefix, 1, prefixSize, fp ) == prefixSize )
+		&& ( size == 0 || fwrite( chunk, 1, size, fp ) == size )
+		&& fwrite( check, 1, 4, fp ) == 4;
+	}
+
+	/// piece of the zlib stream: IDAT for the first image, fdAT for the next frames
+	bool writeData( const png_byte* chunk, size_t size ) {
+	    if ( images <= 1 ) {
+		return writeChunk( "IDAT", chunk, size );
+	    }
+	    png_byte number[4];
+	    putInt( number, sequence++ );
+	    return writeChunk( "fdAT", chunk, size, number );
+	}
+
+	/// tEXt chunk, not compressed as with libpng
+	bool writeText( const char* key, const std::string& text ) {
+	    std::vector<png_byte> chunk( key, key + strlen(key) + 1 );
+	    chunk.insert( chunk.end(), text.begin(), text.end() );
+	    return writeChunk( "tEXt", &chunk[0], chunk.size() );
+	}
+
+	// { big endian
+	static void putInt( png_byte* b, unsigned long i ) {
+	    b[0] = (png_byte)( i >> 24 );
+	    b[1] = (png_byte)( i >> 16 );
+	    b[2] = (png_byte)( i >> 8 );
+	    b[3] = (png_byte)i;
+	}
+
+	static void putShort( png_byte* b, unsigned int i ) {
+	    b[0] = (png_byte)( i >> 8 );
+	    b[1] = (png_byte)i;
+	}
+	// }
+
+	FILE* fp;
+	int width;
+	const int rowBytes;
+	/// bytes of a pixel, at least 1: distance of the pixel a of the filters
+	const int pixelBytes;
+	const int height;
+	const int chunkRows;
+	const int level;
+	const PngCompression::Filter filterType;
+	/// false: the chunks are compressed one after the other
+	const bool parallel;
+
+	/// images started by startImage()
+	int images;
+
+	/// sequence number of the next fcTL or fdAT chunk, -1 if not animated
+	int sequence;
+
+	// { current band
+	const png_byte* data;
+	int begin;
+	int end;
+	bool compressing;
+	// }
+
+	/// last row of the previous band, empty for the first one
+	std::vector<png_byte> previousRow;
+
+	/// end of the last chunk of the previous band
+	std::vector<png_byte> dictionary;
+
+	// { of each chunk of the band
+	std::vector< std::vector<png_byte> > filtered;
+	std::vector< std::vector<png_byte> > compressed;
+	std::vector<uLong> adlers;
+	// }
+
+	/// adler32 of the filtered rows already written
+	uLong adler;
+
+	/// written by the threads of the chunks if deflate fails
+	bool failed;
+    };
+
+    /// color type of the 8 bits PNG files, according to the transparency
+    int colorTypeOf( const bool colored ) {
+	if ( ImageGray::transparency.useAlphaTransparency() ) {
+	    return colored ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_GRAY_ALPHA;
+	} // simple or no transparency
+	return colored ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY;
+    }
+
+    /// transparent color of the simple transparency: the empty color
+    png_color_16 transparentColor() {
+	png_color_16 transparent;
+	transparent.gray = ImageGray::background.getEmpty();
+	transparent.red = ImageGray::background.getEmpty();
+	transparent.green =  ImageGray::background.getEmpty();
+	transparent.blue = ImageGray::background.getEmpty();
+	return transparent;
+    }
+
+    /// Image::images given to writeAPNG
+    class VectorFrames : public AnimationFrames {
+    public:
+	explicit VectorFrames( std::vector<TabRows>& frames ) : frames(frames) {}
+
+	ImageRows& getFrame( int i ) { return frames[i]; }
+
+    private:
+	std::vector<TabRows>& frames;
+    };
+
+    /// write a PNG file by ChunkedPng. returns 1 if succeed, 0 if failed
+    int writeChunked( FILE* fp, int width, int height, int bitDepth, int colorType,
+		      int pixelBytes, PngRows& rows, const std::string& description,
+		      const png_color_16* transparent, Progress& progress ) {
+	const int rowBytes = width * pixelBytes;
+	ChunkedPng png( fp, rowBytes, pixelBytes, height );
+	bool written = png.writeHeader( width, bitDepth, colorType, description, transparent )
+	    && png.startImage();
+	if ( written ) {
+	    PngPipeline pipeline( rows, rowBytes, height, png.bandRows() );
+	    pipeline.write( png, progress );
+	    written = png.endImage() && png.writeEnd();
+	}
+	return fclose(fp) == 0 && written ? 1 : 0;
+    }
 }
 
-#ifdef HAVE_LIBPNG
 int
 ImageGray::savePNG( FILE* fp, const std::string& description ) const {
+    TabRows rows( tab, colored ? colorTab : NULL, width );
+    return writePNG( fp, width, height, colored, rows, description );
+}
+
+int
+ImageGray::writePNG( FILE* fp, const int width, const int height, const bool colored,
+		     ImageRows& rows, const std::string& description ) {
     Progress progress( _("Saving PNG file"), height );
+    EightBitRows converted( rows, width, colored );
+    const int bit_depth = 8;
+    const int color_type = colorTypeOf( colored );
+    png_color_16 transparent = transparentColor();
+    if ( pngCompression.isParallel() ) {
+	return writeChunked( fp, width, height, bit_depth, color_type, converted.pixelBytes(),
+			     converted, description,
+			     transparency.useSimpleTransparency() ? &transparent : NULL, progress );
+    }
+    PngPipeline pipeline( converted, width*converted.pixelBytes(), height );
     // origin: example.c of libpng
     png_structp png_ptr;
     png_infop info_ptr;
@@ -336,96 +1025,26 @@ ImageGray::savePNG( FILE* fp, const std::string& description ) const {
     }
     // I/O initialization
     png_init_io( png_ptr, fp );
+    png_set_compression_level( png_ptr, pngCompression.getLevel() );
+    png_set_filter( png_ptr, PNG_FILTER_TYPE_BASE, libpngFilter( pngCompression.getFilter() ) );
 
-    const int bit_depth = 8;
-    int color_type;
-    if ( transparency.useAlphaTransparency() ) {
-	color_type = colored ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_GRAY_ALPHA;
-    } else { // simple or no transparency
-	color_type = colored ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY;
-    }
     png_set_IHDR( png_ptr, info_ptr, width, height, bit_depth, color_type,
 		  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
     
     // comments into the image (Title, Author, ...)
-    const int text_ptr_size = 2; 
-    png_text text_ptr[text_ptr_size];
-    text_ptr[0].key = "Software";
-    char soft[software.size()+1];
-    software.copy( soft, software.size() );
-    soft[software.size()] = '\0';
-    text_ptr[0].text = soft;
-    text_ptr[0].compression = PNG_TEXT_COMPRESSION_NONE;
-    text_ptr[1].key = "Description";
-    char desc[description.size()+1];
-    description.copy( desc, description.size() );
-    desc[description.size()]='\0';
-    text_ptr[1].text = desc;
-    // As it is difficult to find a software which can retrieve a compressed
-    // text in a PNG file, compression is not used for the moment.
-    // text_ptr[1].compression = PNG_TEXT_COMPRESSION_zTXt;
-    text_ptr[1].compression = PNG_TEXT_COMPRESSION_NONE;
-    png_set_text( png_ptr, info_ptr, text_ptr, text_ptr_size );
+    setText( png_ptr, info_ptr, description );
     
     if ( transparency.useSimpleTransparency() ) {
-	// transparent color:
-	png_color_16 transparent;
-	transparent.gray = background.getEmpty();
-	if ( colored ) {
-	    transparent.red = background.getEmpty();
-	    transparent.green =  background.getEmpty();
-	    transparent.blue = background.getEmpty();
-	}
 	png_set_tRNS( png_ptr, info_ptr, NULL/*trans*/, 0/*trans size*/, &transparent );
     }
 
     // Write the file header information.
     png_write_info( png_ptr, info_ptr );
     
-    // we transfer #tab# to an other format
-    const int bytes_per_pixel = (transparency.useAlphaTransparency() ? 1 : 0) + (colored ? 3 : 1);
-//    png_byte image[height][width*bytes_per_pixel];
-    png_byte* image = new png_byte[height*width*bytes_per_pixel];
-    for ( png_uint_32 y = 0; y < height; ++y ) {
-	progress.setValue(y/2);
-	for ( png_uint_32 x = 0; x < width; ++x ) {
-	    const int posImage = bytes_per_pixel * (x + y*width);
-	    const int posTab = (colored ? 3 : 1) * (x + y*width);
-	    if ( transparency.useAlphaTransparency() ) {
-		if ( colored ) {
-		    image[posImage    ] = colorTab[posTab];
-		    image[posImage + 1] = colorTab[posTab + 1];
-		    image[posImage + 2] = colorTab[posTab + 2];
-		    if ( background.isBlack() ) {
-		        image[posImage + 3] = tab[posTab/3];
-		    } else {
-		        image[posImage + 3] = 255 - tab[posTab/3];
-		    }
-		} else {
-		    image[posImage] = background.getFull();
-		    image[posImage + 1] = 255 - tab[posTab];
-		}
-	    } else {
-		if ( colored ) {
-		    image[posImage] = colorTab[posTab];
-		    image[posImage + 1] = colorTab[posTab + 1];
- 		    image[posImage + 2] = colorTab[posTab + 2];
-		} else {
-		    image[posImage] = tab[posTab];
-		}
-	    }
-	}
-    }
-    png_bytep row_pointer;
-    for ( png_uint_32 k = 0; k < height; ++k ) {
-	progress.setValue(height/2+k/2);
-	row_pointer = (png_bytep)image + k*width*bytes_per_pixel;
-	// we write the pixels
-	png_write_row( png_ptr, row_pointer );
-    }
+    // the rows are converted by a second thread while the previous ones are compressed
+    LibpngBands sink( png_ptr, width*converted.pixelBytes() );
+    pipeline.write( sink, progress );
 
-    delete[] image;
-    
     // finish writing the rest of the file
     png_write_end(png_ptr, info_ptr);
     
@@ -436,79 +1055,190 @@ ImageGray::savePNG( FILE* fp, const std::string& description ) const {
     return 1;
 }
 
-const std::string
-ImageGray::getDescriptionFromPNG( const std::string& file ) {
-    FILE* fp = fopen( file.c_str(), "rb" );
-    if ( fp == NULL ) {
-        throw 2;
+int
+ImageGray::saveAPNG( const std::vector<Image*>& images, FILE* fp, const int delay,
+		     const std::string& description ) {
+    assert( !images.empty() );
+    std::vector<TabRows> frames;
+    for ( int i = 0; i < (int)images.size(); ++i ) {
+	frames.push_back( TabRows( images[i]->tab, images[i]->colored ? images[i]->colorTab : NULL,
+				   images[i]->width ) );
     }
+    VectorFrames source( frames );
+    return writeAPNG( fp, images[0]->width, images[0]->height, images[0]->colored,
+		      images.size(), source, delay, description );
+}
 
-    // first check that it is a PNG file
-    const int PNG_BYTES_TO_CHECK = 4;
-    png_byte buf[PNG_BYTES_TO_CHECK];
-
-    // Read in some of the signature bytes
-    if ( fread( buf, 1, PNG_BYTES_TO_CHECK, fp ) != PNG_BYTES_TO_CHECK ) {
-        fclose(fp);
-        throw 1;
+int
+ImageGray::writeAPNG( FILE* fp, const int width, const int height, const bool colored,
+		      const int frames, AnimationFrames& source, const int delay,
+		      const std::string& description ) {
+    Progress progress( _("Saving APNG file"), frames*height );
+    // only to know the bytes of a pixel
+    EightBitRows pixel( source.getFrame(0), width, colored );
+    const int rowBytes = width * pixel.pixelBytes();
+    png_color_16 transparent = transparentColor();
+    ChunkedPng png( fp, rowBytes, pixel.pixelBytes(), height );
+    bool written = png.writeHeader( width, 8, colorTypeOf( colored ), description,
+				    transparency.useSimpleTransparency() ? &transparent : NULL,
+				    frames );
+    for ( int i = 0; i < frames && written; ++i ) {
+	written = png.startImage( delay );
+	EightBitRows converted( source.getFrame(i), width, colored );
+	PngPipeline pipeline( converted, rowBytes, height, png.bandRows() );
+	pipeline.write( png, progress, i*height );
+	written = written && png.endImage();
     }
+    written = written && png.writeEnd();
+    return fclose(fp) == 0 && written ? 1 : 0;
+}
 
-    // Compare the first PNG_BYTES_TO_CHECK bytes of the signature.
-    if ( png_sig_cmp( buf, (png_size_t)0, PNG_BYTES_TO_CHECK ) ) {
-        fclose(fp);
-        throw 1;
+int
+ImageGray::writePNG16( FILE* fp, const int width, const int height, const bool colored,
+		       HdrRows& rows, const std::string& description ) {
+    Progress progress( _("Saving PNG file"), height );
+    SixteenBitRows converted( rows, width, colored );
+    const int pixelBytes = 2 * ( colored ? 3 : 1 );
+    const int color_type = colored ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY;
+    if ( pngCompression.isParallel() ) {
+	return writeChunked( fp, width, height, 16, color_type, pixelBytes,
+			     converted, description, NULL, progress );
     }
-
-    png_structp png_ptr;
-    png_infop info_ptr;
-
-    // Create and initialize the png_struct with the default error handler functions.
-    png_ptr = png_create_read_struct( PNG_LIBPNG_VER_STRING, NULL, NULL, NULL );
-    
+    PngPipeline pipeline( converted, pixelBytes * width, height );
+    png_structp png_ptr = png_create_write_struct( PNG_LIBPNG_VER_STRING, NULL, NULL, NULL );
     if ( png_ptr == NULL ) {
-        fclose(fp);
-	throw 2;
+	fclose(fp);
+	return 0;
     }
-
-    // Allocate/initialize the memory for image information.
-    info_ptr = png_create_info_struct(png_ptr);
+    png_infop info_ptr = png_create_info_struct(png_ptr);
     if ( info_ptr == NULL ) {
-        fclose(fp);
-	png_destroy_read_struct(&png_ptr, png_infopp_NULL, png_infopp_NULL);
-	throw 2;
+	fclose(fp);
+	png_destroy_write_struct( &png_ptr, (png_infopp)NULL );
+	return 0;
     }
-
-    /* Set error handling if you are using the setjmp/longjmp method (this is
-     * the normal method of doing things with libpng). 
-     */
     if (setjmp(png_jmpbuf(png_ptr))) {
-      // Free all of the memory associated with the png_ptr and info_ptr
-        png_destroy_read_struct(&png_ptr, &info_ptr, png_infopp_NULL);
 	fclose(fp);
-	// If we get here, we had a problem reading the file
-	throw 2;
-     }
+	png_destroy_write_struct( &png_ptr, &info_ptr );
+	return 0;
+    }
+    png_init_io( png_ptr, fp );
+    png_set_compression_level( png_ptr, pngCompression.getLevel() );
+    png_set_filter( png_ptr, PNG_FILTER_TYPE_BASE, libpngFilter( pngCompression.getFilter() ) );
+    png_set_IHDR( png_ptr, info_ptr, width, height, 16, color_type,
+		  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    setText( png_ptr, info_ptr, description );
+    png_write_info( png_ptr, info_ptr );
 
-    png_init_io(png_ptr, fp);
+    LibpngBands sink( png_ptr, pixelBytes * width );
+    pipeline.write( sink, progress );
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct( &png_ptr, &info_ptr );
+    fclose(fp);
+    return 1;
+}
 
-    // If we have already read some of the signature
-    png_set_sig_bytes( png_ptr, PNG_BYTES_TO_CHECK );
+namespace {
+    /// uncompress the zlib stream #data# of a zTXt or iTXt chunk. false if it is corrupted
+    bool inflateText( const std::vector<unsigned char>& data, size_t offset, std::string& text ) {
+	z_stream z;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+	if ( offset >= data.size() || inflateInit( &z ) != Z_OK ) {
+	    return false;
+	}
+	z.next_in = (Bytef*)&data[offset];
+	z.avail_in = data.size() - offset;
+	unsigned char buffer[16384];
+	int ret;
+	do {
+	    z.next_out = buffer;
+	    z.avail_out = sizeof(buffer);
+	    ret = inflate( &z, Z_NO_FLUSH );
+	    text.append( (const char*)buffer, sizeof(buffer) - z.avail_out );
+	} while ( ret == Z_OK );
+	inflateEnd( &z );
+	return ret == Z_STREAM_END;
+    }
 
-    png_read_png( png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, png_voidp_NULL );
-    
-    png_textp text;
-    int num_text;
-    png_get_text( png_ptr, info_ptr, &text, &num_text );
+    /// big endian 4 bytes integer of the PNG chunks
+    unsigned long readUInt32( const unsigned char* b ) {
+	return ( (unsigned long)b[0] << 24 ) | ( (unsigned long)b[1] << 16 )
+	    | ( (unsigned long)b[2] << 8 ) | b[3];
+    }
+}
+
+/* Only the chunks before the image data are read: the pixels are never
+   decompressed, and the IDAT chunks are not even read. Glito, as most
+   programs, writes its text chunks before the image data.
+*/
+const std::string
+ImageGray::getDescriptionFromPNG( const std::string& file ) {
+    FILE* fp = fopen( file.c_str(), "rb" );
+    if ( fp == NULL ) {
+        throw 2;
+    }
+
+    // first check that it is a PNG file
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    unsigned char buf[8];
+    if ( fread( buf, 1, sizeof(buf), fp ) != sizeof(buf)
+	 || memcmp( buf, signature, sizeof(signature) ) != 0 ) {
+        fclose(fp);
+        throw 1;
+    }
+
+    const std::string key = "Description";
     std::string desc;
-    for ( int t = 0; t < num_text; ++t ) {
-	if ( std::string(text[t].key) == "Description" ) {
-    	    desc = text[t].text;
+    std::vector<unsigned char> data;
+    // chunk: length, type, data, crc
+    while ( fread( buf, 1, 8, fp ) == 8 ) {
+	const unsigned long length = readUInt32( buf );
+	const std::string type( (const char*)buf + 4, 4 );
+	if ( type == "IDAT" || type == "IEND" || length > 0x7fffffffUL ) {
+	    break;
+	}
+	const bool text = type == "tEXt" || type == "zTXt" || type == "iTXt";
+	if ( !text ) {
+	    if ( fseek( fp, length + 4, SEEK_CUR ) != 0 ) {
+		break;
+	    }
+	    continue;
+	}
+	data.resize( length );
+	if ( ( length != 0 && fread( &data[0], 1, length, fp ) != length )
+	     || fseek( fp, 4, SEEK_CUR ) != 0 ) {
+	    break;
 	}
+	// keyword, terminated by a 0
+	if ( length <= key.size() || memcmp( &data[0], key.data(), key.size() ) != 0
+	     || data[key.size()] != 0 ) {
+	    continue;
+	}
+	size_t offset = key.size() + 1;
+	bool compressed = type == "zTXt";
+	if ( type == "iTXt" ) {
+	    // compression flag and method, language tag and translated keyword
+	    compressed = offset < length && data[offset] != 0;
+	    offset += 2;
+	    for ( int skip = 0; skip < 2 && offset < length; ++offset ) {
+		skip += ( data[offset] == 0 );
+	    }
+	} else if ( compressed ) {
+	    ++offset; // compression method
+	}
+	std::string found;
+	if ( compressed ) {
+	    if ( !inflateText( data, offset, found ) ) {
+		continue;
+	    }
+	} else if ( offset < length ) {
+	    found.assign( (const char*)&data[offset], length - offset );
+	}
+	desc = found;
+	break;
     }
 
-    // clean up after the read, and free any memory allocated
-    png_destroy_read_struct( &png_ptr, &info_ptr, png_infopp_NULL );
-
     // close the file
     fclose(fp);
 
@@ -516,6 +1246,27 @@ ImageGray::getDescriptionFromPNG( const std::string& file ) {
 }
 #endif
 
+int
+ImageGray::writePFM( FILE* fp, const int width, const int height, const bool colored,
+		     HdrRows& rows ) {
+    Progress progress( _("Saving PFM file"), height );
+    // the samples are written in the byte order of the machine,
+    // given by the sign of the scale: negative for little endian
+    const int one = 1;
+    const bool littleEndian = *(const char*)&one == 1;
+    bool written = fprintf( fp, "%s\n%d %d\n%s\n", colored ? "PF" : "Pf",
+			    width, height, littleEndian ? "-1.0" : "1.0" ) > 0;
+    const int samples_per_row = ( colored ? 3 : 1 ) * width;
+    std::vector<float> samples( samples_per_row );
+    // the rows of a PFM go from the bottom to the top
+    for ( int y = height-1; y >= 0 && written; --y ) {
+	progress.setValue( height-1-y );
+	rows.getRow( y, &samples[0] );
+	written = fwrite( &samples[0], sizeof(float), samples_per_row, fp ) == (size_t)samples_per_row;
+    }
+    return fclose(fp) == 0 && written ? 1 : 0;
+}
+
 #ifdef HAVE_LIBMNG
 typedef struct user_struct {
     FILE *hFile;
@@ -545,19 +1296,159 @@ mng_bool myclosestream( mng_handle myhandle ) {
     return MNG_TRUE;  // gets closed in main function
 }
 
-int
-ImageGray::addChunks( mng_handle myhandle ) const {
+class ImageGray::MngFrames : public RowTask {
+public:
+    MngFrames( const std::vector<Image*>& images, const bool delta )
+	: images(images),
+	  delta( delta && !transparency.useSimpleTransparency()
+		 && !transparency.useAlphaTransparency() ),
+	  frames( images.size() ), first(0) {}
+
+    /// compresses the frames from #first#+#begin# to #first#+#end# (excluded)
+    void rows( int begin, int end ) {
+	for ( int i = first + begin; i < first + end; ++i ) {
+	    compress( i );
+	}
+    }
+
+    /// frames compressed by the next call of Parallel::rows
+    void setFirst( int f ) { first = f; }
+
+    /// chunks of the frame #i#, compressed by rows(). frees the compressed data
+    mng_retcode addChunks( mng_handle myhandle, int i );
+
+private:
+    struct Frame {
+	// { rectangle of the image written
+	int x;
+	int y;
+	int w;
+	int h;
+	// }
+	std::vector<png_byte> compressed;
+    };
+
+    void compress( int i );
+
+    /// rectangle of the pixels of #image# which differ from #previous#
+    static void changedBox( const ImageGray& image, const ImageGray& previous, Frame& frame );
+
+    const std::vector<Image*>& images;
+    /// true if delta frames are written
+    const bool delta;
+    std::vector<Frame> frames;
+    int first;
+};
+
+void
+ImageGray::MngFrames::changedBox( const ImageGray& image, const ImageGray& previous,
+				  Frame& frame ) {
+    int xmin = image.width;
+    int xmax = -1;
+    int ymin = image.height;
+    int ymax = -1;
+    const int bytes_per_pixel = image.colored ? 3 : 1;
+    const unsigned char* tab = image.colored ? image.colorTab : image.tab;
+    const unsigned char* old = image.colored ? previous.colorTab : previous.tab;
+    for ( int y = 0; y < image.height; ++y ) {
+	const int row = y*image.width*bytes_per_pixel;
+	for ( int x = 0; x < image.width*bytes_per_pixel; ++x ) {
+	    if ( tab[row + x] != old[row + x] ) {
+		xmin = std::min( xmin, x / bytes_per_pixel );
+		xmax = std::max( xmax, x / bytes_per_pixel );
+		ymin = std::min( ymin, y );
+		ymax = y;
+	    }
+	}
+    }
+    if ( xmax < 0 ) {
+	// nothing changed: one pixel drawn again
+	xmin = xmax = ymin = ymax = 0;
+    }
+    frame.x = xmin;
+    frame.y = ymin;
+    frame.w = xmax + 1 - xmin;
+    frame.h = ymax + 1 - ymin;
+}
+
+void
+ImageGray::MngFrames::compress( const int i ) {
+    const ImageGray& image = *images[i];
+    Frame& frame = frames[i];
+    frame.x = 0;
+    frame.y = 0;
+    frame.w = image.width;
+    frame.h = image.height;
+    if ( delta && i > 0 && images[i-1]->width == image.width
+	 && images[i-1]->height == image.height && images[i-1]->colored == image.colored ) {
+	changedBox( image, *images[i-1], frame );
+    }
+    const bool alpha = transparency.useAlphaTransparency();
+    const int bytes_per_pixel = ( image.colored ? 3 : 1) + ( alpha ? 1 : 0 );
+    const int rowBytes = 1 + frame.w*bytes_per_pixel;
+    // we add a filter byte to the begining of each row:
+    std::vector<png_byte> extended( rowBytes*frame.h );
+    for ( int y = 0; y < frame.h; ++y ) {
+	png_byte* row = &extended[ y*rowBytes ];
+	row[0] = 0; // the filter
+	const int start = frame.x + (frame.y + y)*image.width;
+	if ( alpha ) {
+	    for ( int x = 0; x < frame.w; ++x ) {
+		png_byte* pixel = row + 1 + x*bytes_per_pixel;
+		const int n = start + x;
+		if ( image.colored ) {
+		    pixel[0] = image.colorTab[  n*3]; // red
+		    pixel[1] = image.colorTab[1+n*3]; // green
+		    pixel[2] = image.colorTab[2+n*3]; // blue
+		} else {
+		    pixel[0] = background.getFull(); //gray
+		}
+		pixel[bytes_per_pixel-1] = background.isBlack()
+		    ? image.tab[n] : 255 - image.tab[n]; // alpha
+	    }
+	} else if ( image.colored ) {
+	    memcpy( row + 1, image.colorTab + start*3, frame.w*3 );
+	} else {
+	    memcpy( row + 1, image.tab + start, frame.w );
+	}
+    }
+    // we compress "extended" to "compressed":
+    uLongf compressedSize = compressBound( extended.size() );
+    frame.compressed.resize( compressedSize );
+    if ( Z_OK != compress2( (Bytef*)&frame.compressed[0], &compressedSize,
+			    (const Bytef*)&extended[0], extended.size(),
+			    pngCompression.getLevel() ) ) {
+	compressedSize = 0; // see addChunks
+    }
+    frame.compressed.resize( compressedSize );
+}
+
+mng_retcode
+ImageGray::MngFrames::addChunks( mng_handle myhandle, const int i ) {
     mng_retcode ret;
+    Frame& frame = frames[i];
+    if ( frame.compressed.empty() ) {
+	return MNG_OUTOFMEMORY;
+    }
+    const bool alpha = transparency.useAlphaTransparency();
+    const bool colored = images[i]->colored;
 
-    if ( transparency.useSimpleTransparency() || transparency.useAlphaTransparency() ) {
+    if ( transparency.useSimpleTransparency() || alpha ) {
 	// to allow a redraw before writting transparent pixel on already hit pixels!
 	ret = mng_putchunk_fram( myhandle, false, 3/*generate background layer*/,
 				 0, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, NULL );
 	if ( ret != MNG_NOERROR ) { return ret; }
     }
 
-    ret = mng_putchunk_ihdr( myhandle, width, height, MNG_BITDEPTH_8,
-			     transparency.useAlphaTransparency() ?
+    if ( delta ) {
+	// the delta frames are drawn over the previous ones (framing mode 1)
+	ret = mng_putchunk_defi( myhandle, 0/*object*/, 0/*shown*/, 0/*not concrete*/,
+				 true, frame.x, frame.y, false, 0, 0, 0, 0 );
+	if ( ret != MNG_NOERROR ) { return ret; }
+    }
+
+    ret = mng_putchunk_ihdr( myhandle, frame.w, frame.h, MNG_BITDEPTH_8,
+			     alpha ?
 			     ( colored ? MNG_COLORTYPE_RGBA : MNG_COLORTYPE_GRAYA)
 			     : (colored ? MNG_COLORTYPE_RGB : MNG_COLORTYPE_GRAY),
 			     MNG_COMPRESSION_DEFLATE, MNG_FILTER_ADAPTIVE, MNG_INTERLACE_NONE );
@@ -577,59 +1468,10 @@ ImageGray::addChunks( mng_handle myhandle ) const {
 
 //    mng_putchunk_bkgd( myhandle, false, MNG_COLORTYPE_GRAY, 0, 0/*gray*/, 0, 0, 0 );
 
-    const int bytes_per_pixel = ( colored ? 3 : 1) + ( transparency.useAlphaTransparency() ? 1 : 0 );
-    // we add a filter byte to the begining of each row:
-    const int extendedSize = (1+width*bytes_per_pixel)*height;
-    png_byte* extended = new png_byte[extendedSize];
-    for ( int y = 0; y < height; ++y ) {
-	extended[ y*(1+width*bytes_per_pixel) ] = 0; // the filter
-	if ( transparency.useAlphaTransparency() ) {
-	    const int xstart = y*(1+width*bytes_per_pixel) + 1;
-	    const int xdelta = colored ? 4 : 2;
-	    for ( int x = xstart, xtab = 0;
-		  x < xstart + width*bytes_per_pixel;
-		  x+=xdelta, ++xtab ) {
-		if ( colored ) {
-		    extended[x  ] = colorTab[  (xtab+y*width)*3]; // red
-		    extended[x+1] = colorTab[1+(xtab+y*width)*3]; // green
-		    extended[x+2] = colorTab[2+(xtab+y*width)*3]; // blue
-		    if ( background.isBlack() ) {
-		        extended[x+3] = tab[xtab+y*width]; // alpha
-		    } else {
-		        extended[x+3] = 255 - tab[xtab+y*width]; // alpha
-		    }
-		} else {
-		    extended[x] = background.getFull(); //gray
-		    if ( background.isBlack() ) {
-		        extended[x+1] = tab[xtab+y*width]; // alpha
-		    } else {
-		        extended[x+1] = 255 - tab[xtab+y*width]; // alpha
-		    }
-		}
-	    }
-	} else {
-	    if ( colored ) {
-	        memcpy( extended + y*(1+width*bytes_per_pixel) + 1, colorTab + y*width*bytes_per_pixel, width*bytes_per_pixel );
-	    } else {
-	        memcpy( extended + y*(1+width) + 1, tab + y*width, width );
-	    }
-	}
-    }
-    // we compress "extended" to "compressed":
-    int compressedSize = extendedSize*101/100 + 12; // large enough for calculations
-    png_byte* compressed = new png_byte[compressedSize];
-    if ( Z_OK != compress2( (Bytef*)compressed, (uLongf*)&compressedSize,
-			    (const Bytef*)extended, (long unsigned int)extendedSize,
-			    Z_DEFAULT_COMPRESSION ) ) { // put 9 for best compression
-	return 0;
-    }
-    
-    delete[] extended;
-    
-    ret = mng_putchunk_idat( myhandle, compressedSize, (mng_ptr*)compressed );
+    // the chunk is copied by libmng
+    ret = mng_putchunk_idat( myhandle, frame.compressed.size(), (mng_ptr)&frame.compressed[0] );
     if ( ret != MNG_NOERROR ) { return ret; }
-
-    delete[] compressed; 
+    std::vector<png_byte>().swap( frame.compressed );
 
     mng_putchunk_iend( myhandle );
     return MNG_NOERROR;
@@ -637,7 +1479,8 @@ ImageGray::addChunks( mng_handle myhandle ) const {
 
 int
 ImageGray::saveMNG( const std::vector<Image*>& images, FILE* fp,
-		const int framesPerSecond, const std::string& description ) {
+		    const int framesPerSecond, const std::string& description,
+		    const bool delta ) {
     Progress progress( _("Saving MNG file"), images.size()-1 );
     // get a data buffer
     userdatap pMydata = (userdatap)calloc( 1, sizeof(userdata) );
@@ -693,10 +1536,17 @@ ImageGray::saveMNG( const std::vector<Image*>& images, FILE* fp,
     mng_putchunk_ztxt( myhandle, 11, "Description",
 		       MNG_COMPRESSION_DEFLATE, description.size(), desc );
 
-    for ( int i = 0; i < images.size(); ++i ) {
-	progress.setValue(i);
-	ret = images[i]->addChunks( myhandle );
-	if ( ret != MNG_NOERROR ) { return 0; }
+    // the frames are compressed by groups of one frame per thread
+    MngFrames frames( images, delta );
+    const int group = Parallel::threads();
+    for ( int first = 0; first < (int)images.size(); first += group ) {
+	progress.setValue(first);
+	frames.setFirst( first );
+	Parallel::rows( frames, std::min( group, (int)images.size() - first ) );
+	for ( int i = first; i < first + group && i < (int)images.size(); ++i ) {
+	    ret = frames.addChunks( myhandle, i );
+	    if ( ret != MNG_NOERROR ) { return 0; }
+	}
     }
 
     mng_putchunk_mend( myhandle );
@@ -23,6 +23,7 @@ USA.
 # include <config.h>
 #endif
 
+#include <cstdio>
 #include <vector>
 #include <fstream>
 
@@ -51,6 +52,9 @@ public:
     // updates the progress bar
     void setValue( const float f );
 
+    /// false in the programs without display (glito-merge): no window is shown
+    static bool enabled;
+
 private:
     Fl_Window* w;
 
@@ -138,8 +142,84 @@ private:
 
 };
 
+/** compression of the PNG files: zlib level, filter of the rows, and
+    whether the rows are compressed by several threads at the same time.
+ */
+class PngCompression {
+public:
+    /// filters of the rows of PNG. ADAPTIVE: the best one for each row
+    enum Filter { NONE, SUB, UP, AVERAGE, PAETH, ADAPTIVE };
+
+    /// constructor. level 6, adaptive filter, parallel
+    PngCompression() : level(6), filter(ADAPTIVE), parallel(true) {}
+
+    /// zlib level: from 0 (no compression) to 9 (smallest file)
+    void setLevel( int l );
+    int getLevel() const { return level; }
+
+    void setFilter( Filter f ) { filter = f; }
+    Filter getFilter() const { return filter; }
+
+    /** true: the rows are split in chunks compressed by all the
+	processors (see Parallel), false: compressed by libpng
+    */
+    void setParallel( bool p ) { parallel = p; }
+    bool isParallel() const { return parallel; }
+
+    // { to save the filter to an XML file and to recover it
+    std::string filterToXML() const;
+    void setFilterFromXML( const std::string& s );
+    // }
+
+private:
+    int level;
+
+    Filter filter;
+
+    bool parallel;
+};
+
 class Image;
 
+/** rows of an image to save, given one after the other in increasing
+    order. Allows to save an image which is never entirely in memory.
+ */
+class ImageRows {
+public:
+    virtual ~ImageRows() {}
+
+    /** fill #gray# (width bytes) with the gray levels of the row #y# and,
+	if the image is colored, #color# (3*width bytes) with its colors
+    */
+    virtual void getRow( int y, unsigned char* gray, unsigned char* color ) = 0;
+};
+
+/** rows of a high dynamic range image to save (see writePNG16 and
+    writePFM). The rows may be asked in any order.
+ */
+class HdrRows {
+public:
+    virtual ~HdrRows() {}
+
+    /** fill #samples# with the levels of the row #y#: width floats, or
+	3*width (red, green, blue) if the image is colored. in [0, 1] for
+	the 16 bits PNG, any value for PFM
+    */
+    virtual void getRow( int y, float* samples ) = 0;
+};
+
+/** frames of an animation to save (see writeAPNG), asked one after the
+    other. Allows to save frames which are calculated while the animation
+    is written.
+ */
+class AnimationFrames {
+public:
+    virtual ~AnimationFrames() {}
+
+    /// rows of the frame #i#, used until the next call
+    virtual ImageRows& getFrame( int i ) = 0;
+};
+
 /**
  * 8 bits image with utilities to save it to different formats
  */
@@ -152,12 +232,18 @@ public:
 
     static Transparency transparency;
 
+    static PngCompression pngCompression;
+
     enum imageFormat {
 	PGM,
 	BMPB, // BMP bitmap
 	BMPG, // BMP gray
 	PNG,  // gray 8bits
-	MNG   // gray 8bits or gray_alpha
+	MNG,  // gray 8bits or gray_alpha
+	PNG16, // gray or rgb 16bits
+	PFM,  // gray or rgb 32bits float
+	APNG, // animated PNG, as PNG
+	VIDEO // Y4M or RGB stream, see VideoStream
     };
 
     /// used by Main.cpp
@@ -190,27 +276,73 @@ public:
     /// write a PNG image. returns 1 if succeed, 0 if failed
     int savePNG( FILE* f, const std::string& description ) const;
 
-    /** read the description contained in a PNG file
+    /** write a PNG image of size width*height whose rows are given by #rows#.
+	returns 1 if succeed, 0 if failed. used by savePNG and for the posters
+    */
+    static int writePNG( FILE* f, int width, int height, bool colored,
+			 ImageRows& rows, const std::string& description );
+
+    /** write a 16 bits PNG image of size width*height whose rows are given
+	by #rows#, without transparency. returns 1 if succeed, 0 if failed
+    */
+    static int writePNG16( FILE* f, int width, int height, bool colored,
+			   HdrRows& rows, const std::string& description );
+
+    /** write an animated PNG (APNG) of the #images# (same size), each
+	shown #delay# milli-seconds, played forever. Written without
+	libpng (see PngCompression). returns 1 if succeed, 0 if failed
+    */
+    static int saveAPNG( const std::vector<Image*>& images, FILE* f, int delay,
+			 const std::string& description );
+
+    /** write an APNG of #frames# frames of size width*height given by
+	#source#. returns 1 if succeed, 0 if failed
+    */
+    static int writeAPNG( FILE* f, int width, int height, bool colored, int frames,
+			  AnimationFrames& source, int delay, const std::string& description );
+
+    /** read the description contained in a PNG file. Only the chunks
+     * before the image data are read, the pixels are not decoded.
      * @throw 1 if the file is not a PNG file
      * @throw 2 if no description is found
      */
     static const std::string getDescriptionFromPNG( const std::string& file );
 #endif // HAVE_LIBPNG
 
+    /** write a PFM image (Portable Float Map: 32 bits float samples) of
+	size width*height whose rows are given by #rows#. PFM has no room
+	for a description. returns 1 if succeed, 0 if failed
+    */
+    static int writePFM( FILE* f, int width, int height, bool colored, HdrRows& rows );
+
 #ifdef HAVE_LIBMNG
-    /// write a MNG animation. returns 1 if succeed, 0 if failed
+    /** write a MNG animation. The frames are compressed by several
+	threads (see Parallel). #delta#: when the images have no
+	transparency, a frame only holds the rectangle of the pixels which
+	changed since the previous one, drawn over it.
+	returns 1 if succeed, 0 if failed
+    */
     static int saveMNG( const std::vector<Image*>& images, FILE* f,
-			const int framesPerSecond, const std::string& description );
+			const int framesPerSecond, const std::string& description,
+			bool delta = false );
 #endif // HAVE_LIBMNG
 
     bool isColored() const { return colored; }
+
+    // { pixels drawn by mem_draw, row after row. used by VideoStream
+    /// width*height gray levels
+    const unsigned char* grayLevels() const { return tab; }
+    /// 3*width*height bytes (red, green, blue), NULL if not colored
+    const unsigned char* colors() const { return colored ? colorTab : NULL; }
+    // }
  
 protected:
     /// called by constructors
     void copy(const ImageGray& other );
 
 #ifdef HAVE_LIBMNG
-    int addChunks( mng_handle myhandle ) const;
+    /// compresses the frames of saveMNG and adds their chunks
+    class MngFrames;
 #endif
 
     // { save tab to f. the header of the file has already been saved. 
@@ -19,6 +19,7 @@ USA.
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cctype>
 
 #include "IndentedString.hpp"
 
@@ -246,6 +247,158 @@ ToXML::extractAll( const string& str, const string& tag ) {
     return IS::extractAll( str, tagOpen, tagClose );
 }
 
+XMLWriter::XMLWriter( int level ) : justOpened( false ) {
+    for( int i = 0; i < level; ++i ) {
+	tabTotal.append( "    " );
+    }
+}
+
+XMLWriter&
+XMLWriter::open( const string& tag ) {
+    res.append( tabTotal ).append( 1, '<' ).append( tag ).append( ">\n" );
+    tabTotal.append( "    " );
+    openedBranchs.push( tag );
+    justOpened = true;
+    return *this;
+}
+
+XMLWriter&
+XMLWriter::close() {
+    if ( justOpened ) {
+	// as ToXML::elementIR with an empty value
+	res.append( tabTotal ).append( 1, '\n' );
+    }
+    tabTotal.resize( tabTotal.size() - 4 );
+    res.append( tabTotal ).append( "</" ).append( openedBranchs.top() ).append( ">\n" );
+    openedBranchs.pop();
+    justOpened = false;
+    return *this;
+}
+
+XMLWriter&
+XMLWriter::element( const string& tag, const string& val ) {
+    res.append( tabTotal ).append( 1, '<' ).append( tag ).append( 1, '>' );
+    // without the final blanks, and the next lines indented, as endCleanup and addTab
+    const string::size_type end = val.find_last_not_of( " \n\r\t" ) + 1;
+    string::size_type a = 0;
+    for ( string::size_type b = val.find( '\n' ); b < end; b = val.find( '\n', a ) ) {
+	res.append( val, a, b + 1 - a ).append( tabTotal );
+	a = b + 1;
+    }
+    res.append( val, a, end - a ).append( "</" ).append( tag ).append( ">\n" );
+    justOpened = false;
+    return *this;
+}
+
+namespace {
+    /// letters, digits and the punctuation allowed in the names of XML tags
+    bool isNameChar( const char c ) {
+	return isalnum( (unsigned char)c ) || c == '_' || c == '-' || c == '.' || c == ':';
+    }
+}
+
+FromXML::FromXML( const string& str ) : document( str ) {
+    Node whole;
+    whole.tag = 0;
+    whole.tagSize = 0;
+    whole.begin = 0;
+    whole.end = document.size();
+    nodes.push_back( whole );
+    // elements whose closing tag is still expected, starting with the document
+    vector< int > opened( 1, 0 );
+    string::size_type a = document.find( '<' );
+    while ( a != string::npos ) {
+	if ( document.compare( a, 4, "<!--" ) == 0 ) {
+	    a = document.find( "-->", a + 4 );
+	    a = ( a == string::npos ) ? a : document.find( '<', a + 3 );
+	    continue;
+	}
+	const string::size_type b = document.find( '>', a + 1 );
+	if ( b == string::npos ) {
+	    break;
+	}
+	const bool closing = document[a+1] == '/';
+	const string::size_type n = a + 1 + ( closing ? 1 : 0 );
+	string::size_type e = n;
+	while ( e < b && isNameChar( document[e] ) ) {
+	    ++e;
+	}
+	if ( e == n || !( e == b || isspace( (unsigned char)document[e] ) || document[e] == '/' ) ) {
+	    // not a tag: "<?xml ...>", or a '<' of the text as in the formulas
+	    a = document.find( '<', a + 1 );
+	    continue;
+	}
+	if ( !closing ) {
+	    Node node;
+	    node.tag = n;
+	    node.tagSize = e - n;
+	    node.begin = b + 1;
+	    node.end = b + 1;
+	    node.last = nodes.size();
+	    nodes.push_back( node );
+	    if ( document[b-1] != '/' ) {
+		opened.push_back( node.last );
+	    }
+	} else {
+	    int k = opened.size() - 1;
+	    while ( k > 0 && ( nodes[opened[k]].tagSize != e - n
+			       || document.compare( nodes[opened[k]].tag, e - n, document, n, e - n ) != 0 ) ) {
+		--k;
+	    }
+	    if ( k > 0 ) {
+		// the unclosed elements inside end with the element closed
+		for ( int i = opened.size() - 1; i >= k; --i ) {
+		    nodes[opened[i]].end = a;
+		    nodes[opened[i]].last = nodes.size() - 1;
+		}
+		opened.resize( k );
+	    }
+	}
+	a = document.find( '<', b + 1 );
+    }
+    for ( int i = opened.size() - 1; i >= 0; --i ) {
+	nodes[opened[i]].end = document.size();
+	nodes[opened[i]].last = nodes.size() - 1;
+    }
+}
+
+string
+FromXML::Element::text() const {
+    if ( !found() ) {
+	return "";
+    }
+    const Node& node = document->nodes[index];
+    return document->document.substr( node.begin, node.end - node.begin );
+}
+
+FromXML::Element
+FromXML::Element::first( const string& tag ) const {
+    if ( found() ) {
+	const vector< Node >& nodes = document->nodes;
+	for ( int i = index + 1; i <= nodes[index].last; ++i ) {
+	    if ( document->hasTag( i, tag ) ) {
+		return Element( document, i );
+	    }
+	}
+    }
+    return Element( document, -1 );
+}
+
+vector< FromXML::Element >
+FromXML::Element::all( const string& tag ) const {
+    vector< Element > res;
+    if ( found() ) {
+	const vector< Node >& nodes = document->nodes;
+	for ( int i = index + 1; i <= nodes[index].last; ++i ) {
+	    if ( document->hasTag( i, tag ) ) {
+		res.push_back( Element( document, i ) );
+		i = nodes[i].last;
+	    }
+	}
+    }
+    return res;
+}
+
 /*
 int main() {
     std::cerr << "Test of IndentedString\n";
@@ -263,6 +416,17 @@ int main() {
         const std::string s = "<test>foo</test>";
 	assert( ToXML::extractFirst( s, "test" ) == "foo" );
     }
+    {
+        assert( XMLWriter().open( "a" ).element( "b", "1\n2 " ).close().getValue()
+		== ToXML().elementIR( "a", ToXML().elementI( "b", "1\n2 " ).getValue() ).getValue() );
+    }
+    {
+        const FromXML xml( "<a><f><x>1</x></f><!-- <f> --><f><x>< x 2</x></f><n/></a>" );
+	assert( xml.root().all( "f" ).size() == 2 );
+	assert( xml.root().all( "f" )[1].value( "x" ) == "< x 2" );
+	assert( xml.root().value( "x" ) == "1" );
+	assert( xml.root().first( "n" ).found() && !xml.root().first( "y" ).found() );
+    }
     std::cerr << "End Test of IndentedString\n";
 }
 */
@@ -248,6 +248,113 @@ namespace IS {
 	static vector< string > extractAll( const string& str, const string& tag );
     };
 
+    /** XML written element after element into a single string, as ToXML
+	writes it but without building and indenting again the string of
+	each level: open/close replace elementIR, element replaces elementI.
+    */
+    class XMLWriter {
+    public:
+	/// the elements are indented #level# times
+	explicit XMLWriter( int level = 0 );
+
+	/// /t/t/t <tag> /n. The next elements are indented once more
+	XMLWriter& open( const string& tag );
+
+	/// /t/t/t </tag> /n, for the last tag opened
+	XMLWriter& close();
+
+	/// /t/t/t <tag>val</tag> /n
+	template< typename Value > XMLWriter& element( const string& tag, Value val ) {
+	    return element( tag, translate( val ) );
+	}
+	XMLWriter& element( const string& tag, const string& val );
+
+	/// the XML string
+	const string& getValue() const { return res; }
+
+    private:
+	/// contains the XML data
+	string res;
+
+	/// "    " times the level
+	string tabTotal;
+
+	/// stack used by #close#
+	stack< string > openedBranchs;
+
+	/// true if nothing was written since the last #open#
+	bool justOpened;
+    };
+
+    /** XML document read once by the constructor: the elements form a
+	tree, each of them knowing where its content is in the document.
+	Searching an element does not scan the document again as extractFirst.
+	The text is not unescaped (ToXML does not escape it).
+    */
+    class FromXML {
+    public:
+	/// parse #str#. Comments, declarations and unclosed elements are tolerated
+	explicit FromXML( const string& str );
+
+	/// an element of the document, valid while the FromXML exists
+	class Element {
+	public:
+	    /// false if the element was not found
+	    bool found() const { return index >= 0; }
+
+	    /// the string between <tag> and </tag>, "" if not found
+	    string text() const;
+
+	    /// first element <tag> inside this one, at any depth, in the order of the document
+	    Element first( const string& tag ) const;
+
+	    /// all the elements <tag> inside this one, but not the ones inside them
+	    vector< Element > all( const string& tag ) const;
+
+	    /// text of first( #tag# ): as ToXML::extractFirst
+	    string value( const string& tag ) const { return first( tag ).text(); }
+
+	private:
+	    friend class FromXML;
+
+	    Element( const FromXML* d, int i ) : document( d ), index( i ) {}
+
+	    const FromXML* document;
+
+	    /// in #nodes#, -1 if not found
+	    int index;
+	};
+
+	/// the whole document
+	Element root() const { return Element( this, 0 ); }
+
+    private:
+	struct Node {
+	    /// name of the element: #tagSize# characters at #tag# in #document#
+	    string::size_type tag;
+	    string::size_type tagSize;
+	    /// content of the element: [begin, end[ in #document#
+	    string::size_type begin;
+	    string::size_type end;
+	    /** index of the last element inside this one. The elements are
+		stored in the order of their opening tags, so the ones inside
+		the element #i# are i+1 to last
+	    */
+	    int last;
+	};
+
+	/// true if the tag of the element #i# is #tag#
+	bool hasTag( int i, const string& tag ) const {
+	    return nodes[i].tagSize == tag.size()
+		&& document.compare( nodes[i].tag, nodes[i].tagSize, tag ) == 0;
+	}
+
+	const string document;
+
+	/// #nodes[0]# is the whole document, without tag
+	vector< Node > nodes;
+    };
+
 }
 
 /** @memo translate an STL #pair# to an XML string.
@@ -41,6 +41,7 @@ USA.
 #include "IndentedString.hpp"
 #include "Glito.hpp"
 #include "Skeleton.hpp"
+#include "Benchmark.hpp"
 // include config.h:
 #include "Image.hpp"
 
@@ -119,8 +120,24 @@ void saveSnapshot_cb( Fl_Widget* w, void* ) {
     glito->saveSnapshot();
     glito->needRedraw = true;
 }
+
+void savePoster_cb( Fl_Widget* w, void* ) {
+    fl_message( _("Format: '%s'\nResolution: %d x %d\nThe image is built by bands: it can be larger than the memory."),
+		Image::formatToString(Image::PNG).c_str(),
+		glito->imageSavedWidth, glito->imageSavedHeight );
+    glito->savePoster();
+    glito->needRedraw = true;
+}
 #endif // HAVE_LIBPNG
 
+void resumeCheckpoint_cb( Fl_Widget* w, void* ) {
+    const char* p = fl_file_chooser( _("Open Checkpoint"), "*.gz", NULL );
+    if ( p != NULL ) {
+	glito->resumeCheckpoint( p );
+	glito->needRedraw = true;
+    }
+}
+
 void saveImage_cb( Fl_Widget* w, void* f ) {
     const Image::imageFormat format = (Image::imageFormat)(int)f;
     fl_message( _("Format: '%s'\nResolution: %d x %d\nUse the arrows on the keyboard to move the image.\nPress space bar to save the calculated image."),
@@ -140,8 +157,7 @@ void readColorMap_cb( Fl_Widget*, void* ) {
         const string colorText = IS::readStringInFile(p);
 	if ( !IS::extractFirst( colorText, "color_map {", "}" ).empty() ) {
 	    Image::readColorMap( colorText );
-	    glito->state = PREVIEW;
-	    glito->needRedraw = true;
+	    glito->recolor();
 	} else {
 	    fl_alert( _("Failed to open \"%s\"."), p );
 	}
@@ -151,10 +167,11 @@ void readColorMap_cb( Fl_Widget*, void* ) {
 void readDefinedMap_cb( Fl_Widget* w, void* v ) {
     if ( !glito->isColored() ) {
         glito->setColored(true);
+	glito->needRedraw = true;
     }
     const int map = (int)v;
     Image::readDefinedMap( map );
-    glito->needRedraw = true;
+    glito->recolor();
 }
 
 void open_parameters_cb( Fl_Widget*, void* ) {
@@ -175,9 +192,10 @@ void save_parameters_cb( Fl_Widget* w, void* ) {
     // bug in fltk ? the second time, paramFile is not shown in the file_chooser
     if ( p != NULL ) {
 	paramFile = string(p);
-	IS::ToXML()
-	    .elementIR( "parameters", glito->parametersToXML(0) )
-	    .save( paramFile );
+	IS::XMLWriter xml;
+	xml.open( "parameters" );
+	glito->parametersToXML( xml );
+	IS::saveStringToFile( paramFile, xml.close().getValue() );
     }
 }
 
@@ -309,7 +327,7 @@ void blackWhite_param( Fl_Button* w, void* ) {
     const bool b = !ImageGray::background.isBlack();
     w->value( !b );
     ImageGray::background.setBlack( b );
-    glito->needRedraw = true;
+    glito->recolor();
 }
 
 void transparency_param( Fl_Button* w, void* t ) {
@@ -912,32 +930,51 @@ void animation_rotation_cb( Fl_Widget* w, void* ) {
 }
 
 void animation_stop_cb( Fl_Widget* w, void* ) {
-    if ( glito->state == ANIMATION || glito->state == DEMO ) {
+    if ( glito->state == ANIMATION || glito->state == DEMO || glito->state == SAVEPOSTER ) {
         glito->state = PREVIEW;
     }
     glito->needRedraw = true;
 }
 
-void saveAnimation_cb( Fl_Widget* w, void* f ) {
-    const int anim = (int)f; 
-    if ( anim == 0 ) { // zoom
-	if ( Function::system == LINEAR ) {
-	    if ( glito->skel.selected() == 0 ) {
-		fl_alert( _("To zoom inside the general frame is not allowed!") );
-		return;
-	    }
-	} else {
-	    fl_alert( _("The zoom animation requires a \"linear\" system.") );
-	    return;
+/// true if the zoom animation can be saved, otherwise tells why
+bool zoomAllowed() {
+    if ( Function::system == LINEAR ) {
+	if ( glito->skel.selected() == 0 ) {
+	    fl_alert( _("To zoom inside the general frame is not allowed!") );
+	    return false;
 	}
+    } else {
+	fl_alert( _("The zoom animation requires a \"linear\" system.") );
+	return false;
     }
-    const Image::imageFormat format = Image::MNG;
+    return true;
+}
+
+/// f: animation (0 zoom, 1 transition, 2 rotation), plus 3 for APNG
+void saveAnimation_cb( Fl_Widget* w, void* f ) {
+    const int anim = (int)f % 3;
+    if ( anim == 0 && !zoomAllowed() ) {
+	return;
+    }
+    const Image::imageFormat format = ( (int)f < 3 ) ? Image::MNG : Image::APNG;
     fl_message( _("Format: '%s'\nResolution: %d x %d\n\nPress space bar to cancel calculation."),
 		Image::formatToString(format).c_str(),
 		glito->animationSavedWidth, glito->animationSavedHeight );
     glito->startSave( format, anim );
 }
 
+/// f: animation (0 zoom, 1 transition, 2 rotation, 3 demo)
+void saveVideo_cb( Fl_Widget* w, void* f ) {
+    const int anim = (int)f;
+    if ( anim == 0 && !zoomAllowed() ) {
+	return;
+    }
+    fl_message( _("Format: '%s'\nResolution: %d x %d\n\nPress space bar to stop the video."),
+		Image::formatToString(Image::VIDEO).c_str(),
+		glito->animationSavedWidth, glito->animationSavedHeight );
+    glito->startSave( Image::VIDEO, anim );
+}
+
 //////////////////////////////////////////////////////////////////////
 // Menu Help
 
@@ -960,6 +997,8 @@ void about_cb( Fl_Widget* w, void* ) {
 void usage() {
     cerr << _("Usage:") << " glito [-p " << _("paramFile")
 	 << ".xml] [" << _("skeletonFile") << ".ifs]\n"
+	 << "       glito -b [" << _("skeletonFile") << "...]  "
+	 << _("benchmarks of the calculation") << "\n"
 	 << _("Report bugs to <glito@debanne.net>.\n");
 }
 
@@ -1344,9 +1383,10 @@ int main( int argc, char **argv ) {
     Fl_File_Chooser::preview_label = _("Preview");
     Fl_File_Chooser::show_label = _("Show:");
     string skeletonToOpen;
+    bool benchmark = false;
 #ifdef HAVE_UNISTD_H
     while ( true ) {
-	int c = getopt( argc, argv, "vhp:" );
+	int c = getopt( argc, argv, "vhbp:" );
 	if ( c == -1 ) {
 	    break;
 	}
@@ -1354,6 +1394,9 @@ int main( int argc, char **argv ) {
 	case 'p':
 	    paramFile = optarg;
 	    break;
+	case 'b':
+	    benchmark = true;
+	    break;
 	case 'v':
 	    cerr << "Glito v" << VERSION << "\nCopyright (C) 2002-2003 Emmanuel Debanne\n"
 		 << _("Glito is distributed under the terms of the GNU General Public License.\n");
@@ -1364,6 +1407,13 @@ int main( int argc, char **argv ) {
 	    return 0;
 	}
     }
+    if ( benchmark ) {
+	Benchmark::plotting( cout );
+	if ( optind < argc ) {
+	    Benchmark::layouts( cout, vector<string>( argv + optind, argv + argc ) );
+	}
+	return 0;
+    }
     if ( optind < argc ) {
 	skeletonToOpen = argv[optind];
 	++optind;
@@ -1409,14 +1459,18 @@ int main( int argc, char **argv ) {
     {_("Set Fast Save Directory"), 0, set_snapshotPath_cb},
     {_("Fast Save"),        'f', saveSnapshot_cb, NULL, FL_MENU_DIVIDER},
     {_("Save PNG"),         0, saveImage_cb, (void*)Image::PNG},
+    {_("Save PNG Poster"),  0, savePoster_cb},
+    {_("Save PNG 16 bits"), 0, saveImage_cb, (void*)Image::PNG16},
 #endif
     {_("Save PGM"),         0, saveImage_cb, (void*)Image::PGM},
+    {_("Save PFM"),         0, saveImage_cb, (void*)Image::PFM},
     {_("Save BMP bitmap"),  0, saveImage_cb, (void*)Image::BMPB},
-    {_("Save BMP gray"),    0, saveImage_cb, (void*)Image::BMPG, FL_MENU_DIVIDER},
+    {_("Save BMP gray"),    0, saveImage_cb, (void*)Image::BMPG},
+    {_("Resume Checkpoint"), 0, resumeCheckpoint_cb, 0, FL_MENU_DIVIDER},
     {_("Edit &Paramaters"), 'p', parameters_cb},
     {_("Open Paramaters"),  0, open_parameters_cb},
     {_("Sa&ve parameters"), 0, save_parameters_cb, 0, FL_MENU_DIVIDER},
-    {_("&Quit"),	    FL_CTRL+'Q', quit_cb}, //10
+    {_("&Quit"),	    FL_CTRL+'Q', quit_cb}, //12
     {0},
     {_("&Skeleton"),      0, 0, 0, FL_SUBMENU},
     {_("&New"),           FL_CTRL+'N', skeleton_new_cb},
@@ -1426,7 +1480,7 @@ int main( int argc, char **argv ) {
     {_("out Memory1"),    '1', outMemory_cb, (void*)1},
     {_("out Memory2"),    '2', outMemory_cb, (void*)2},
     {_("out Memory3"),    '3', outMemory_cb, (void*)3},
-    {_("out Memory4"),    '4', outMemory_cb, (void*)4, FL_MENU_DIVIDER},//20
+    {_("out Memory4"),    '4', outMemory_cb, (void*)4, FL_MENU_DIVIDER},//22
     {_("in Memory1"),     '5', inMemory_cb, (void*)1},
     {_("in Memory2"),     '6', inMemory_cb, (void*)2},
     {_("in Memory3"),     '7', inMemory_cb, (void*)3},
@@ -1438,12 +1492,12 @@ int main( int argc, char **argv ) {
     {_("&Cut"),           FL_CTRL+'X', function_cut_cb},
     {_("C&opy"),          FL_CTRL+'C', function_copy_cb},
     {_("&Paste"),         FL_CTRL+'V', function_paste_cb, 0, FL_MENU_DIVIDER},
-    {_("&Reshape"),       's', function_reshape_cb, 0, FL_MENU_DIVIDER}, //32
-    // the following items are modified by Glito::setSystemType()
-    {_("&Linear"),        0, systemType_cb, (void *)LINEAR,     FL_MENU_RADIO|FL_MENU_VALUE}, //33
-    {_("&Sinusoidal"),    0, systemType_cb, (void *)SINUSOIDAL, FL_MENU_RADIO}, //34
-    {_("&Julia"),         0, systemType_cb, (void *)JULIA,      FL_MENU_RADIO}, //35
-    {_("&Formulas"),      0, systemType_cb, (void *)FORMULA,    FL_MENU_RADIO|FL_MENU_DIVIDER}, //36
+    {_("&Reshape"),       's', function_reshape_cb, 0, FL_MENU_DIVIDER}, //34
+    // the following items are modified by Glito::setSystemType(). numbers without libpng
+    {_("&Linear"),        0, systemType_cb, (void *)LINEAR,     FL_MENU_RADIO|FL_MENU_VALUE}, //35
+    {_("&Sinusoidal"),    0, systemType_cb, (void *)SINUSOIDAL, FL_MENU_RADIO}, //36
+    {_("&Julia"),         0, systemType_cb, (void *)JULIA,      FL_MENU_RADIO}, //37
+    {_("&Formulas"),      0, systemType_cb, (void *)FORMULA,    FL_MENU_RADIO|FL_MENU_DIVIDER}, //38
     {_("&Edit Formulas"), 0, edit_formula_cb},
     {0},
     {_("&Color"),         0, 0, 0, FL_SUBMENU},
@@ -1468,6 +1522,15 @@ int main( int argc, char **argv ) {
     {_("Save Transition as MNG"), 0, saveAnimation_cb, (void*)1},
     {_("Save Rotation as MNG"),   0, saveAnimation_cb, (void*)2},
 #endif
+#ifdef HAVE_LIBPNG
+    {_("Save Zoom as APNG"),       0, saveAnimation_cb, (void*)3},
+    {_("Save Transition as APNG"), 0, saveAnimation_cb, (void*)4},
+    {_("Save Rotation as APNG"),   0, saveAnimation_cb, (void*)5},
+#endif
+    {_("Save Zoom as Video"),       0, saveVideo_cb, (void*)0},
+    {_("Save Transition as Video"), 0, saveVideo_cb, (void*)1},
+    {_("Save Rotation as Video"),   0, saveVideo_cb, (void*)2},
+    {_("Save Demo as Video"),       0, saveVideo_cb, (void*)3},
     {0},
     {_("&Help"),          0, 0, 0, FL_SUBMENU},
     {_("Docu&mentation"), FL_F+1, documentation_cb},
@@ -0,0 +1,266 @@
+// glito/Merge.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+/* glito-merge: adds the checkpoints written by several computers which
+   calculated the same image (same skeleton and framing, different
+   random seeds), then saves the sum as a PNG image and/or a checkpoint.
+   It does not need a display.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+// getopt
+#endif
+
+#ifdef HAVE_SETLOCALE
+# include <locale.h>
+#endif
+
+#include "Checkpoint.hpp"
+#include "Image.hpp"
+#include "IndentedString.hpp"
+
+#ifdef ENABLE_NLS
+# include <libintl.h>
+# define _(String) gettext (String)
+#else
+# define _(String) (String)
+#endif
+
+using namespace std;
+
+namespace {
+    /** rows of the image of a checkpoint: the counters are reduced by
+	squares of factor x factor pixels (see ImageSupersampled), then
+	tone mapped. Only a row is in memory beside the checkpoint.
+    */
+    class CheckpointRows : public ImageRows {
+    public:
+	explicit CheckpointRows( const Checkpoint& c )
+	    : c(c), width( c.width / c.factor ), toneMap( maxHitOf(c) ),
+	      hits( width ), rgb( c.colored ? 3*width : 0 ) {}
+
+	void getRow( int y, unsigned char* gray, unsigned char* color ) {
+	    reduce( c, y, &hits[0], c.colored ? &rgb[0] : NULL );
+	    for ( int x = 0; x < width; ++x ) {
+		toneMap.pixel( hits[x], c.colored ? &rgb[3*x] : NULL,
+			       gray[x], c.colored ? color + 3*x : NULL );
+	    }
+	}
+
+    private:
+	/// sum of the hits and mean color of the squares of the row #y#
+	static void reduce( const Checkpoint& c, int y, int* hits, float* rgb ) {
+	    const int width = c.width / c.factor;
+	    if ( c.factor == 1 ) {
+		// the colors as ImageDensity, without the rounding of the mean
+		for ( int x = 0; x < width; ++x ) {
+		    const size_t n = (size_t)y * c.width + x;
+		    hits[x] = c.hits[n];
+		    if ( rgb != NULL ) {
+			if ( hits[x] != 0 ) {
+			    Image::colorOf( c.coords[n], rgb + 3*x );
+			} else {
+			    std::fill( rgb + 3*x, rgb + 3*x + 3, 0.0f );
+			}
+		    }
+		}
+		return;
+	    }
+	    for ( int x = 0; x < width; ++x ) {
+		long long sum = 0;
+		float rgbSum[3] = { 0, 0, 0 };
+		for ( int k = 0; k < c.factor; ++k ) {
+		    const size_t row = (size_t)( y*c.factor + k ) * c.width;
+		    for ( int l = x*c.factor; l < (x+1)*c.factor; ++l ) {
+			const int h = c.hits[row + l];
+			sum += h;
+			if ( rgb != NULL && h != 0 ) {
+			    float pixel[3];
+			    Image::colorOf( c.coords[row + l], pixel );
+			    rgbSum[0] += h * pixel[0];
+			    rgbSum[1] += h * pixel[1];
+			    rgbSum[2] += h * pixel[2];
+			}
+		    }
+		}
+		hits[x] = (int)( sum < ImageDensity::maxMaxHit ? sum : ImageDensity::maxMaxHit );
+		if ( rgb != NULL ) {
+		    for ( int k = 0; k < 3; ++k ) {
+			rgb[3*x+k] = sum != 0 ? rgbSum[k] / sum : 0;
+		    }
+		}
+	    }
+	}
+
+	static int maxHitOf( const Checkpoint& c ) {
+	    const int width = c.width / c.factor;
+	    std::vector<int> hits( width );
+	    int maxHit = 0;
+	    for ( int y = 0; y < c.height / c.factor; ++y ) {
+		reduce( c, y, &hits[0], NULL );
+		for ( int x = 0; x < width; ++x ) {
+		    maxHit = std::max( maxHit, hits[x] );
+		}
+	    }
+	    return maxHit;
+	}
+
+	const Checkpoint& c;
+	const int width;
+	const ToneMap toneMap;
+	std::vector<int> hits;
+	std::vector<float> rgb;
+    };
+
+    void usage() {
+	cerr << _("Usage:") << " glito-merge [-o " << _("image") << ".png] [-k "
+	     << _("merged") << ".gz] [-f " << _("framing") << ".gz]\n"
+	     << "                   [-m " << _("map") << " | -c " << _("colorMap")
+	     << ".map] [-w] " << _("checkpoint") << ".gz...\n"
+	     << _("Adds the checkpoints of the same skeleton and framing.\n")
+	     << "  -o  " << _("save the sum as a PNG image") << "\n"
+	     << "  -k  " << _("save the sum as a checkpoint") << "\n"
+	     << "  -f  " << _("save a checkpoint without hits to be resumed by each computer") << "\n"
+	     << "  -m  " << _("defined color map (-1 to 5, see Color->Color map)") << "\n"
+	     << "  -c  " << _("color map file (pov-ray format)") << "\n"
+	     << "  -w  " << _("white background") << "\n"
+	     << _("Report bugs to <glito@debanne.net>.\n");
+    }
+}
+
+int main( int argc, char **argv ) {
+#ifdef HAVE_SETLOCALE
+    setlocale( LC_MESSAGES, "" );
+    setlocale( LC_NUMERIC, "POSIX" );
+#endif
+#ifdef ENABLE_NLS
+    bindtextdomain( PACKAGE, LOCALEDIR );
+    textdomain( PACKAGE );
+#endif
+    Progress::enabled = false;
+    // default color map of the colored images
+    Image::readDefinedMap( -1 );
+    string imageFile;
+    string mergedFile;
+    string framingFile;
+#ifdef HAVE_UNISTD_H
+    while ( true ) {
+	const int c = getopt( argc, argv, "ho:k:f:m:c:w" );
+	if ( c == -1 ) {
+	    break;
+	}
+	switch ( c ) {
+	case 'o':
+	    imageFile = optarg;
+	    break;
+	case 'k':
+	    mergedFile = optarg;
+	    break;
+	case 'f':
+	    framingFile = optarg;
+	    break;
+	case 'm':
+	    Image::readDefinedMap( atoi(optarg) );
+	    break;
+	case 'c': {
+	    const string colorText = IS::readStringInFile( optarg );
+	    if ( IS::extractFirst( colorText, "color_map {", "}" ).empty() ) {
+		cerr << _("Failed to open: ") << optarg << '\n';
+		return 1;
+	    }
+	    Image::readColorMap( colorText );
+	    break;
+	}
+	case 'w':
+	    ImageGray::background.setBlack( false );
+	    break;
+	default:
+	case 'h':
+	    usage();
+	    return 0;
+	}
+    }
+#else
+    const int optind = 1;
+#endif
+    if ( optind >= argc || ( imageFile.empty() && mergedFile.empty() && framingFile.empty() ) ) {
+	usage();
+	return 1;
+    }
+    Checkpoint sum;
+    Checkpoint part;
+    for ( int i = optind; i < argc; ++i ) {
+	Checkpoint& c = ( i == optind ) ? sum : part;
+	if ( !c.load( argv[i] ) ) {
+	    cerr << argv[i] << _(" is not a checkpoint.\n");
+	    return 1;
+	}
+	if ( i != optind ) {
+	    if ( !sum.sameFrame( part ) ) {
+		cerr << argv[i] << _(" does not have the skeleton, the framing and the size of ")
+		     << argv[optind] << ".\n";
+		return 1;
+	    }
+	    sum.add( part );
+	}
+    }
+    part.resize( 0, 0, false );
+    if ( sum.width % sum.factor != 0 || sum.height % sum.factor != 0 ) {
+	cerr << argv[optind] << _(" is not a checkpoint.\n");
+	return 1;
+    }
+    if ( !mergedFile.empty() && !sum.save( mergedFile ) ) {
+	cerr << _("Failed to write: ") << mergedFile << '\n';
+	return 1;
+    }
+    if ( !imageFile.empty() ) {
+#ifdef HAVE_LIBPNG
+	FILE* fp = fopen( imageFile.c_str(), "wb" );
+	CheckpointRows rows( sum );
+	if ( fp == NULL
+	     || !ImageGray::writePNG( fp, sum.width / sum.factor, sum.height / sum.factor,
+				      sum.colored, rows, sum.skeleton ) ) {
+	    cerr << _("Failed to write: ") << imageFile << '\n';
+	    return 1;
+	}
+#else
+	cerr << _("Glito was compiled without libpng.\n");
+	return 1;
+#endif
+    }
+    if ( !framingFile.empty() ) {
+	std::fill( sum.hits.begin(), sum.hits.end(), 0 );
+	std::fill( sum.coords.begin(), sum.coords.end(), 0.0f );
+	if ( !sum.save( framingFile ) ) {
+	    cerr << _("Failed to write: ") << framingFile << '\n';
+	    return 1;
+	}
+    }
+    return 0;
+}
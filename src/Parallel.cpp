@@ -0,0 +1,158 @@
+// glito/Parallel.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+  
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#include <vector>
+#include <algorithm>
+
+#include "Parallel.hpp"
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+// sysconf
+#endif
+
+namespace {
+    /// 0 until the first call of Parallel::threads()
+    int nbThreads = 0;
+
+    /// given to Parallel::setThreads
+    int setting = 0;
+
+#ifdef HAVE_LIBPTHREAD
+    /// rows given to a thread
+    struct Interval {
+	RowTask* task;
+	int begin;
+	int end;
+    };
+
+    void* runInterval( void* p ) {
+	Interval* interval = (Interval*)p;
+	interval->task->rows( interval->begin, interval->end );
+	return NULL;
+    }
+
+    void* runBackground( void* p ) {
+	((BackgroundTask*)p)->run();
+	return NULL;
+    }
+#endif // HAVE_LIBPTHREAD
+}
+
+int
+Parallel::threads() {
+    if ( nbThreads == 0 ) {
+	setThreads(0);
+    }
+    return nbThreads;
+}
+
+int
+Parallel::threadsSetting() {
+    return setting;
+}
+
+void
+Parallel::setThreads( const int n ) {
+    setting = std::max( n, 0 );
+#ifdef HAVE_LIBPTHREAD
+    if ( n > 0 ) {
+	nbThreads = n;
+    } else {
+# if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+	nbThreads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+# endif
+	if ( nbThreads < 1 ) {
+	    nbThreads = 1;
+	}
+    }
+#else
+    nbThreads = 1;
+#endif // HAVE_LIBPTHREAD
+}
+
+void
+Parallel::rows( RowTask& task, const int nbRows ) {
+    const int n = std::min( threads(), nbRows );
+    if ( n <= 1 ) {
+	task.rows( 0, nbRows );
+	return;
+    }
+#ifdef HAVE_LIBPTHREAD
+    std::vector<Interval> intervals(n);
+    std::vector<pthread_t> ids(n);
+    std::vector<bool> started(n, false);
+    for ( int t = 0; t < n; ++t ) {
+	intervals[t].task = &task;
+	intervals[t].begin = (int)( (long long)nbRows * t / n );
+	intervals[t].end = (int)( (long long)nbRows * (t+1) / n );
+    }
+    // the calling thread does the first interval itself
+    for ( int t = 1; t < n; ++t ) {
+	started[t] = pthread_create( &ids[t], NULL, runInterval, &intervals[t] ) == 0;
+    }
+    task.rows( intervals[0].begin, intervals[0].end );
+    for ( int t = 1; t < n; ++t ) {
+	if ( started[t] ) {
+	    pthread_join( ids[t], NULL );
+	} else { // no more thread available
+	    task.rows( intervals[t].begin, intervals[t].end );
+	}
+    }
+#endif // HAVE_LIBPTHREAD
+}
+
+Parallel::Background::Background() : running(false), thread(NULL) {
+}
+
+Parallel::Background::~Background() {
+    wait();
+}
+
+void
+Parallel::Background::start( BackgroundTask& task ) {
+    wait();
+#ifdef HAVE_LIBPTHREAD
+    pthread_t* id = new pthread_t;
+    if ( pthread_create( id, NULL, runBackground, &task ) == 0 ) {
+	thread = id;
+	running = true;
+	return;
+    }
+    delete id;
+#endif // HAVE_LIBPTHREAD
+    // no thread available
+    task.run();
+}
+
+void
+Parallel::Background::wait() {
+#ifdef HAVE_LIBPTHREAD
+    if ( running ) {
+	pthread_t* id = (pthread_t*)thread;
+	pthread_join( *id, NULL );
+	delete id;
+	thread = NULL;
+	running = false;
+    }
+#endif // HAVE_LIBPTHREAD
+}
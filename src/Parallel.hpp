@@ -0,0 +1,92 @@
+// glito/Parallel.hpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+  
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+/** work on the rows of an image which can be shared between threads.
+    rows() is called at the same time for disjoint intervals of rows.
+ */
+class RowTask {
+public:
+    virtual ~RowTask() {}
+
+    /// do the work of the rows from #begin# to #end# (excluded)
+    virtual void rows( int begin, int end ) = 0;
+};
+
+/// work done by a second thread while the calling thread goes on
+class BackgroundTask {
+public:
+    virtual ~BackgroundTask() {}
+
+    virtual void run() = 0;
+};
+
+/** threads for the long calculations on the images.
+    Without pthread, everything is done by the calling thread.
+ */
+namespace Parallel {
+
+    /// number of threads used by rows(). 1 without pthread
+    int threads();
+
+    /// 0: as many threads as processors
+    void setThreads( int n );
+
+    /// value given to setThreads. to save it in the file of parameters
+    int threadsSetting();
+
+    /** call task.rows() on [0, nbRows) split in threads() intervals,
+	one per thread. returns when all the rows are done
+    */
+    void rows( RowTask& task, int nbRows );
+
+    /** one task at a time run by a second thread.
+	Without pthread, start() runs the task itself
+    */
+    class Background {
+    public:
+	Background();
+
+	/// wait for the end of the task
+	~Background();
+
+	/// wait for the end of the previous task, then run #task# in the background
+	void start( BackgroundTask& task );
+
+	/// returns when the task is done
+	void wait();
+
+    private:
+	Background( const Background& );
+	Background& operator=( const Background& );
+
+	/// true between start() and wait()
+	bool running;
+
+	/// pthread_t
+	void* thread;
+    };
+}
+
+#endif // PARALLEL_HPP
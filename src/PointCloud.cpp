@@ -0,0 +1,246 @@
+// glito/PointCloud.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#include <cstdlib>
+// rand
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "PointCloud.hpp"
+#include "Engine.hpp"
+#include "Parallel.hpp"
+#include "GzFile.hpp"
+
+using namespace GzFile;
+
+namespace {
+    const char magic[] = "glito point cloud\n";
+
+    /// false for the infinite coordinates and NaN of the diverging orbits
+    bool isFinite( float v ) { return fabs(v) <= std::numeric_limits<float>::max(); }
+}
+
+class PointCloud::Projection : public RowTask {
+public:
+    Projection( const PointCloud& cloud, const Zoom& zoom )
+	: first(0), screen(blockSize), cloud(cloud), zoom(zoom) {}
+
+    /// projects the points #first#+begin to #first#+end
+    void rows( int begin, int end ) {
+	// toScreen writes in the Zoom: a copy for each thread
+	const Zoom z( zoom );
+	for ( int k = begin; k < end; ++k ) {
+	    float px;
+	    float py;
+	    cloud.point( first + k, px, py, screen[k].c );
+	    z.toScreen( px, py );
+	    screen[k].i = z.screenX;
+	    screen[k].j = z.screenY;
+	}
+    }
+
+    /// points projected by a call of Parallel::rows
+    static const int blockSize = 1 << 16;
+
+    struct Point {
+	int i;
+	int j;
+	float c;
+    };
+
+    /// first point of the block
+    size_t first;
+
+    /// the points of the block on the screen
+    std::vector<Point> screen;
+
+private:
+    const PointCloud& cloud;
+
+    const Zoom& zoom;
+};
+
+PointCloud::PointCloud()
+    : x(0), y(0), color(0), points(0), xmin(0), xmax(0), ymin(0), ymax(0),
+      boxXmin(0), boxXmax(0), boxYmin(0), boxYmax(0) {
+}
+
+void
+PointCloud::clear() {
+    points = 0;
+    skeleton.clear();
+    std::vector<float>().swap( floats );
+    std::vector<unsigned short>().swap( shorts );
+}
+
+bool
+PointCloud::build( const Skeleton& skel, const int n, const int framingPoints, const bool quantized ) {
+    clear();
+    if ( Function::system == JULIA || n <= 0 ) {
+	return false;
+    }
+    const MinMax frame = skel.findFrame( framingPoints, x, y, color );
+    xmin = frame.xMin();
+    xmax = frame.xMax();
+    ymin = frame.yMin();
+    ymax = frame.yMax();
+    skel.setXY( x, y, color );
+    // as Engine::iterBuildPoints: the orbits of the formulas get a new seed every 1000 points
+    const bool seeded = Function::system == FORMULA || Function::system == SINUSOIDAL;
+    std::vector<float> xyc;
+    xyc.reserve( 3*(size_t)n );
+    for ( int i = 0; i < n; ++i ) {
+	if ( seeded && i % 1000 == 0 ) {
+	    x = (float)rand()*2/RAND_MAX - 1;
+	    y = (float)rand()*2/RAND_MAX - 1;
+	    skel.setXY( x, y, color );
+	}
+	skel.nextPoint( x, y, color );
+	if ( isFinite(x) && isFinite(y) ) {
+	    xyc.push_back( x );
+	    xyc.push_back( y );
+	    xyc.push_back( color );
+	}
+    }
+    store( xyc, quantized );
+    skeleton = skel.toXML();
+    return points > 0;
+}
+
+void
+PointCloud::store( const std::vector<float>& xyc, const bool quantized ) {
+    points = xyc.size() / 3;
+    if ( !quantized ) {
+	floats = xyc;
+	return;
+    }
+    boxXmin = boxYmin = std::numeric_limits<float>::max();
+    boxXmax = boxYmax = -std::numeric_limits<float>::max();
+    for ( size_t n = 0; n < xyc.size(); n += 3 ) {
+	boxXmin = std::min( boxXmin, xyc[n] );
+	boxXmax = std::max( boxXmax, xyc[n] );
+	boxYmin = std::min( boxYmin, xyc[n+1] );
+	boxYmax = std::max( boxYmax, xyc[n+1] );
+    }
+    const float scaleX = boxXmax > boxXmin ? 65535 / ( boxXmax - boxXmin ) : 0;
+    const float scaleY = boxYmax > boxYmin ? 65535 / ( boxYmax - boxYmin ) : 0;
+    shorts.resize( xyc.size() );
+    for ( size_t n = 0; n < xyc.size(); n += 3 ) {
+	shorts[n] = (unsigned short)( ( xyc[n] - boxXmin ) * scaleX + 0.5f );
+	shorts[n+1] = (unsigned short)( ( xyc[n+1] - boxYmin ) * scaleY + 0.5f );
+	shorts[n+2] = (unsigned short)( std::max( 0.0f, std::min( 1.0f, xyc[n+2] ) ) * 65535 + 0.5f );
+    }
+}
+
+MinMax
+PointCloud::framing() const {
+    MinMax minmax;
+    minmax.candidates( xmin, ymin );
+    minmax.candidates( xmax, ymax );
+    minmax.build();
+    return minmax;
+}
+
+void
+PointCloud::replay( const Zoom& zoom, Image& image, PlotBins* bins, const int distance ) const {
+    Projection projection( *this, zoom );
+    PlotPipeline pipeline( image, bins == NULL ? distance : 0 );
+    for ( size_t first = 0; first < (size_t)points; first += Projection::blockSize ) {
+	const int count = (int)std::min( (size_t)Projection::blockSize, points - first );
+	projection.first = first;
+	Parallel::rows( projection, count );
+	for ( int k = 0; k < count; ++k ) {
+	    const Projection::Point& p = projection.screen[k];
+	    if ( bins != NULL ) {
+		bins->plot( p.i, p.j, p.c );
+	    } else {
+		pipeline.plot( p.i, p.j, p.c );
+	    }
+	}
+    }
+}
+
+int
+PointCloud::save( const std::string& file ) const {
+    gzFile f = create( file );
+    if ( f == NULL ) {
+	return 0;
+    }
+    const bool quantized = !shorts.empty();
+    const float header[11] = { xmin, xmax, ymin, ymax,
+			       boxXmin, boxXmax, boxYmin, boxYmax, x, y, color };
+    const bool written = writeHeader( f, magic, version )
+	&& writeInt( f, points ) && writeInt( f, quantized ? 1 : 0 )
+	&& write( f, header, sizeof(header) )
+	&& writeInt( f, (int)skeleton.size() )
+	&& write( f, skeleton.data(), skeleton.size() )
+	&& ( quantized ? write( f, &shorts[0], shorts.size()*sizeof(unsigned short) )
+	     : points == 0 || write( f, &floats[0], floats.size()*sizeof(float) ) );
+    return commit( f, file, written );
+}
+
+int
+PointCloud::load( const std::string& file, const std::string& expected ) {
+    clear();
+    gzFile f = gzopen( file.c_str(), "rb" );
+    if ( f == NULL ) {
+	return 0;
+    }
+    int n = 0;
+    int q = 0;
+    int length = 0;
+    float header[11];
+    bool valid = readHeader( f, magic, version )
+	&& readInt( f, n ) && n >= 0 && n <= std::numeric_limits<int>::max() / 3
+	&& readInt( f, q )
+	&& read( f, header, sizeof(header) )
+	&& readInt( f, length ) && length >= 0;
+    if ( valid ) {
+	std::vector<char> xml( length + 1, '\0' );
+	valid = read( f, &xml[0], length );
+	skeleton = &xml[0];
+	// a cloud of another skeleton is not allocated to be discarded
+	valid = valid && ( expected.empty() || skeleton == expected );
+	if ( valid && q != 0 ) {
+	    shorts.resize( 3*(size_t)n );
+	    valid = n == 0 || read( f, &shorts[0], shorts.size()*sizeof(unsigned short) );
+	} else if ( valid ) {
+	    floats.resize( 3*(size_t)n );
+	    valid = n == 0 || read( f, &floats[0], floats.size()*sizeof(float) );
+	}
+    }
+    gzclose( f );
+    if ( !valid ) {
+	clear();
+	return 0;
+    }
+    points = n;
+    xmin = header[0];
+    xmax = header[1];
+    ymin = header[2];
+    ymax = header[3];
+    boxXmin = header[4];
+    boxXmax = header[5];
+    boxYmin = header[6];
+    boxYmax = header[7];
+    x = header[8];
+    y = header[9];
+    color = header[10];
+    return 1;
+}
@@ -0,0 +1,148 @@
+// glito/PointCloud.hpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#ifndef POINTCLOUD_HPP
+#define POINTCLOUD_HPP
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "Skeleton.hpp"
+
+class Zoom;
+class Image;
+class PlotBins;
+
+/** points of the orbit of a skeleton (x, y, color), calculated once and
+    plotted again through any Zoom: a new size or framing of the image
+    needs no iteration of the skeleton. Not used for the julia orbits,
+    which depend on the hits of the image (see Julia).
+    The points are stored as floats or, if quantized, as 16 bits integers
+    in the bounding box of the points (6 bytes instead of 12).
+    The file is compressed by zlib (gzip format). It contains, in the
+    byte order of the machine which wrote it:
+    - "glito point cloud\n" and the version (int)
+    - number of points (int), 1 if quantized (int)
+    - framing: xmin, xmax, ymin, ymax (floats)
+    - bounding box of the points: xmin, xmax, ymin, ymax (floats)
+    - last point of the orbit: x, y, color (floats)
+    - length of the XML of the skeleton (int), then the XML
+    - the points: x, y, color (3 floats or 3 unsigned shorts each)
+*/
+class PointCloud {
+public:
+    /// empty cloud
+    PointCloud();
+
+    /// number of points
+    int size() const { return points; }
+
+    /// true if the cloud holds points of the skeleton whose XML is #xml#
+    bool matches( const std::string& xml ) const { return points > 0 && xml == skeleton; }
+
+    /** calculate #n# points of the orbit of #skel#, after its framing by
+	Skeleton::findFrame on #framingPoints# points. returns false for
+	the julia orbits (the cloud is then empty)
+    */
+    bool build( const Skeleton& skel, int n, int framingPoints, bool quantized );
+
+    /// framing of the skeleton, as returned by Skeleton::findFrame
+    MinMax framing() const;
+
+    /** plot all the points through #zoom# to #image#, or to #bins# if not
+	NULL (bins->flush() must then be called), else with the prefetch
+	#distance# (see PlotPipeline). The points are projected by all the
+	threads (see Parallel), then plotted by the calling one: the images
+	are not shared between threads
+    */
+    void replay( const Zoom& zoom, Image& image, PlotBins* bins, int distance ) const;
+
+    /** write the cloud to #file#.tmp, then rename it #file#.
+	returns 1 if succeed, 0 if failed
+    */
+    int save( const std::string& file ) const;
+
+    /** read #file#. returns 1 if succeed, 0 if it is not a point cloud of
+	this version or, if #expected# is not empty, if it is not the cloud
+	of the skeleton #expected#: its points are then not read (the cloud
+	is then empty)
+    */
+    int load( const std::string& file, const std::string& expected = "" );
+
+    /// free the points
+    void clear();
+
+    static const int version = 1;
+
+    // { point of the orbit after the last point of the cloud
+    float x;
+    float y;
+    float color;
+    // }
+
+    /// XML of the skeleton and of its system
+    std::string skeleton;
+
+private:
+    /// projects the points of replay() to the screen
+    class Projection;
+
+    /// point #n#
+    void point( size_t n, float& px, float& py, float& pc ) const {
+	if ( shorts.empty() ) {
+	    px = floats[3*n];
+	    py = floats[3*n+1];
+	    pc = floats[3*n+2];
+	} else {
+	    px = boxXmin + shorts[3*n] * ( boxXmax - boxXmin ) / 65535;
+	    py = boxYmin + shorts[3*n+1] * ( boxYmax - boxYmin ) / 65535;
+	    pc = shorts[3*n+2] / 65535.0f;
+	}
+    }
+
+    /// store the float points #xyc# (x, y, color), quantized or not
+    void store( const std::vector<float>& xyc, bool quantized );
+
+    int points;
+
+    // { MinMax of the framing
+    float xmin;
+    float xmax;
+    float ymin;
+    float ymax;
+    // }
+
+    // { bounding box of the points, used by the quantization
+    float boxXmin;
+    float boxXmax;
+    float boxYmin;
+    float boxYmax;
+    // }
+
+    /// x, y, color of each point if not quantized
+    std::vector<float> floats;
+
+    /// x, y, color of each point in [0, 65535] if quantized
+    std::vector<unsigned short> shorts;
+};
+
+#endif // POINTCLOUD_HPP
@@ -238,27 +238,41 @@ Skeleton::findFrame( const int imax, float& x, float& y, float& color ) const {
 
 string
 Skeleton::toXML( int level, const bool withSelected ) const {
-    IS::ToXML in(level);
-    in.add( Function::systemToXML() );
-    in.elementIR( "generalFrame", f[0].toXML(level) );
-    in.elementI( "nbFunction", nb );
+    IS::XMLWriter xml(level);
+    toXML( xml, withSelected );
+    return xml.getValue();
+}
+
+void
+Skeleton::toXML( IS::XMLWriter& xml, const bool withSelected ) const {
+    xml.open( "skeleton" );
+    Function::systemToXML( xml );
+    xml.open( "generalFrame" );
+    f[0].toXML( xml );
+    xml.close();
+    xml.element( "nbFunction", nb );
     if ( withSelected ) {
-	in.elementI( "selectedFunction", selectedFunction );
+	xml.element( "selectedFunction", selectedFunction );
     }
     for ( int n = 1; n <= nb; ++n ) {
-	in.add( f[n].toXML() );
+	f[n].toXML( xml );
     }
-    IS::ToXML res(level);
-    return res.elementIR( "skeleton", in.getValue() ).getValue();
+    xml.close();
 }
 
 bool
 Skeleton::fromXML( const string& sXML ) {
-    vector< string > functions = IS::ToXML::extractAll( sXML, "function" );
+    const IS::FromXML xml( sXML );
+    return fromXML( xml.root() );
+}
+
+bool
+Skeleton::fromXML( const IS::FromXML::Element& sXML ) {
+    const vector< IS::FromXML::Element > functions = sXML.all( "function" );
     if ( functions.empty() ) {
 	return false;
     }
-    string snb( IS::ToXML::extractFirst( sXML, "nbFunction" ) );
+    string snb( sXML.value( "nbFunction" ) );
     Function::systemFromXML( sXML );
     assert ( functions.size() == 1 + atoi( snb.c_str() ) );
     for ( int i = 0; i < functions.size(); ++i ) {
@@ -47,6 +47,13 @@ public:
     float centerY() const { assert(built); return centerY_; }
     // }
 
+    // { bounds of the box. used to save the framing of a calculation (see Checkpoint)
+    float xMin() const { return xmin; }
+    float xMax() const { return xmax; }
+    float yMin() const { return ymin; }
+    float yMax() const { return ymax; }
+    // }
+
     bool hasInfinity() const;
 
 private:
@@ -117,11 +124,17 @@ public:
     /// converts the Skeleton to an XML string, withSelected used to save a MNG rotation or zoom
     std::string toXML( int level = 0, const bool withSelected = false ) const;
 
+    /// writes the Skeleton to #xml#
+    void toXML( IS::XMLWriter& xml, const bool withSelected = false ) const;
+
     /** retrieves a Skeleton from an XML string
 	@return true if succeed
     */
     bool fromXML( const std::string& sXML );
 
+    /// retrieves a Skeleton from the element #sXML# of a parsed XML document
+    bool fromXML( const IS::FromXML::Element& sXML );
+
     /// converts a Skeleton to a string for Fractint  
     std::string toFractint( const std::string& name ) const;
 
@@ -0,0 +1,134 @@
+// glito/Video.cpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#include <algorithm>
+#include <csignal>
+
+#include "Video.hpp"
+
+#ifdef WIN32
+# define popen _popen
+# define pclose _pclose
+#endif
+
+VideoStream::VideoStream()
+    : fp(NULL), piped(false), format(Y4M), width(0), height(0), colored(false),
+      written(true) {
+}
+
+VideoStream::~VideoStream() {
+    close();
+}
+
+bool
+VideoStream::open( const std::string& target, const Format f, const int w, const int h,
+		   const bool c, const int delay ) {
+    close();
+    piped = !target.empty() && target[0] == '|';
+    if ( piped ) {
+#ifdef SIGPIPE
+	// a command which ends too early makes the writing fail instead of killing glito
+	signal( SIGPIPE, SIG_IGN );
+#endif
+	fp = popen( target.substr(1).c_str(), "w" );
+    } else {
+	fp = fopen( target.c_str(), "wb" );
+    }
+    if ( fp == NULL ) {
+	return false;
+    }
+    format = f;
+    width = w;
+    height = h;
+    colored = c;
+    gray.resize( (size_t)width*height );
+    color.resize( colored ? (size_t)3*width*height : 0 );
+    written = true;
+    if ( format == Y4M ) {
+	// full range as the PNG images, frame rate 1000/delay
+	written = fprintf( fp, "YUV4MPEG2 W%d H%d F1000:%d Ip A1:1 C%s XCOLORRANGE=FULL\n",
+			   width, height, std::max( delay, 1 ), colored ? "444" : "mono" ) > 0;
+    }
+    return written;
+}
+
+bool
+VideoStream::add( const ImageGray& image ) {
+    writer.wait();
+    if ( fp == NULL || !written ) {
+	return false;
+    }
+    std::copy( image.grayLevels(), image.grayLevels() + gray.size(), gray.begin() );
+    if ( colored ) {
+	std::copy( image.colors(), image.colors() + color.size(), color.begin() );
+    }
+    writer.start( *this );
+    return true;
+}
+
+int
+VideoStream::close() {
+    writer.wait();
+    if ( fp == NULL ) {
+	return 0;
+    }
+    const bool closed = piped ? pclose( fp ) == 0 : fclose( fp ) == 0;
+    fp = NULL;
+    return written && closed ? 1 : 0;
+}
+
+void
+VideoStream::run() {
+    const size_t pixels = gray.size();
+    if ( format == Y4M && !colored ) {
+	written = fputs( "FRAME\n", fp ) >= 0
+	    && fwrite( &gray[0], 1, pixels, fp ) == pixels;
+	return;
+    }
+    out.resize( 3*pixels );
+    if ( format == Y4M ) {
+	// planes Y, Cb, Cr of JPEG (BT.601 full range), in fixed point.
+	// pure blue and pure red give a chroma of 256: clamped to 255
+	for ( size_t n = 0; n < pixels; ++n ) {
+	    const int r = color[3*n];
+	    const int g = color[3*n+1];
+	    const int b = color[3*n+2];
+	    out[n]          = (unsigned char)( ( 77*r + 150*g + 29*b + 128 ) >> 8 );
+	    out[pixels+n]   = (unsigned char)std::min( ( 32896 - 43*r - 85*g + 128*b ) >> 8, 255 );
+	    out[2*pixels+n] = (unsigned char)std::min( ( 32896 + 128*r - 107*g - 21*b ) >> 8, 255 );
+	}
+	written = fputs( "FRAME\n", fp ) >= 0;
+    } else if ( colored ) {
+	std::copy( color.begin(), color.end(), out.begin() );
+    } else {
+	for ( size_t n = 0; n < pixels; ++n ) {
+	    out[3*n] = out[3*n+1] = out[3*n+2] = gray[n];
+	}
+    }
+    written = written && fwrite( &out[0], 1, out.size(), fp ) == out.size();
+}
+
+std::string
+VideoStream::formatToXML( const Format f ) {
+    return f == RGB ? "rgb" : "y4m";
+}
+
+VideoStream::Format
+VideoStream::formatFromXML( const std::string& s ) {
+    return s == "rgb" ? RGB : Y4M;
+}
@@ -0,0 +1,105 @@
+// glito/Video.hpp  v1.1  2004.09.05
+/* Copyright (C) 1996, 2002-2004 Emmanuel Debanne
+
+   This file is part of Glito.
+   Glito is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+   Glito is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+   You should have received a copy of the GNU General Public License
+along with Glito (named COPYING); if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+USA.
+*/
+
+#ifndef VIDEO_HPP
+#define VIDEO_HPP
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ImageGray.hpp"
+#include "Parallel.hpp"
+
+/** frames of an animation written one after the other as a raw video,
+    so that a long animation is never entirely in memory:
+    - Y4M (YUV4MPEG2): gray levels, or full range YUV 4:4:4 if colored
+    - RGB: 3 bytes per pixel, without header
+    to a file or, if the target begins with '|', to the standard input of
+    a command (for example "| ffmpeg -i - video.mp4").
+    A frame is converted and written by a second thread while the next
+    one is calculated: only one copy of the pixels is kept.
+*/
+class VideoStream : public BackgroundTask {
+public:
+    enum Format { Y4M, RGB };
+
+    VideoStream();
+
+    /// close() if still open
+    ~VideoStream();
+
+    /** start a video of frames of size #width# * #height#, each shown
+	#delay# milli-seconds. returns false if #target# can not be opened
+    */
+    bool open( const std::string& target, Format format, int width, int height,
+	       bool colored, int delay );
+
+    bool isOpen() const { return fp != NULL; }
+
+    /** add the frame #image#, drawn by mem_draw. Its pixels are copied:
+	the image can be changed at once.
+	returns false if the writing of a previous frame failed
+    */
+    bool add( const ImageGray& image );
+
+    /// write the last frame and close. returns 1 if all the frames were written, 0 if failed
+    int close();
+
+    /// called by the second thread: writes the copied frame
+    void run();
+
+    // { to save the format to the file of parameters and to recover it
+    static std::string formatToXML( Format f );
+    static Format formatFromXML( const std::string& s );
+    // }
+
+private:
+    VideoStream( const VideoStream& );
+    VideoStream& operator=( const VideoStream& );
+
+    FILE* fp;
+
+    /// true if #fp# is the input of a command
+    bool piped;
+
+    Format format;
+    int width;
+    int height;
+    bool colored;
+
+    // { copy of the last frame given to add()
+    std::vector<unsigned char> gray;
+    std::vector<unsigned char> color;
+    // }
+
+    /// frame in the format of the video
+    std::vector<unsigned char> out;
+
+    /// false once a writing failed. written by the second thread
+    bool written;
+
+    /// last member: destroyed first, so the writing ends before the frames are freed
+    Parallel::Background writer;
+};
+
+#endif // VIDEO_HPP